@@ -0,0 +1,170 @@
+/* ------------------------------------------------------------ *
+ * file:        awbench.c                                       *
+ * purpose:     compare the suncalc -w day file writer backends *
+ *              on many small files.                            *
+ *                                                              *
+ * return:      0 on success, and -1 on errors.                 *
+ *                                                              *
+ * example:	./awbench -n 20000 -s 27360 -o ./awbench-data  *
+ *                                                              *
+ * awbench writes the same set of files with each backend, the *
+ * size defaults to a 1 minute day bin file. The files of a    *
+ * run are removed before the next one, so each run creates    *
+ * new files, like suncalc after remove_data(). The backends   *
+ * take turns over several rounds, in a rotating order, and    *
+ * the median run is shown: file system journal commits make   *
+ * single runs vary a lot.                                      *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // various, atoi
+#include <stdio.h>     // run display
+#include <string.h>    // string handling
+#include <unistd.h>    // getopt, unlink
+#include <getopt.h>    // arg handling
+#include <sys/stat.h>  // mkdir
+#include <time.h>      // run time
+#include "awrite.h"    // day file writer backends
+
+/* ------------------------------------------------------------ *
+ * global variables and defaults                                *
+ * ------------------------------------------------------------ */
+int verbose = 0;
+char progver[] = "1.2";              // awbench program version, same as suncalc
+char benchdir[256] = "./awbench-data"; // folder for the test files
+int files = 20000;                   // files per backend
+int filesize = 27360;                // bytes per file, 1440 records of 19 bytes
+int rounds = 5;                      // runs per backend
+
+/* ------------------------------------------------------------ *
+ * print_usage() prints the programs commandline instructions.  *
+ * ------------------------------------------------------------ */
+void usage() {
+   static char const usage[] = "Usage: ./awbench [-n files] [-s size] [-r rounds] [-o folder] [-v]\n\
+\n\
+Command line parameters have the following format:\n\
+   -n   number of files per backend, Example: -n 20000 (default)\n\
+   -s   size of each file in bytes, Example: -s 27360 (default)\n\
+   -r   runs per backend, the median is shown, Example: -r 5 (default)\n\
+   -o   folder for the test files, Example: -o ./awbench-data (default)\n\
+   -h   display this message\n\
+   -v   enable debug output\n\
+\n\
+Usage example:\n\
+./awbench -n 100000 -s 2048 -o /mnt/nvme/awbench\n";
+   printf("awbench v%s\n\n", progver);
+   printf(usage);
+}
+
+/* ----------------------------------------------------------- *
+ * parseargs() checks the commandline arguments with C getopt  *
+ * ----------------------------------------------------------- */
+void parseargs(int argc, char* argv[]) {
+   int arg;
+   opterr = 0;
+
+   while ((arg = (int) getopt (argc, argv, "n:s:r:o:hv")) != -1) {
+      switch (arg) {
+         case 'v':
+            verbose = 1; break;
+         case 'n':
+            files = atoi(optarg);
+            if(files < 1) {
+               printf("Error: Cannot get valid file count.\n");
+               exit(-1);
+            }
+            break;
+         case 's':
+            filesize = atoi(optarg);
+            if(filesize < 0) {
+               printf("Error: Cannot get valid file size.\n");
+               exit(-1);
+            }
+            break;
+         case 'r':
+            rounds = atoi(optarg);
+            if(rounds < 1 || rounds > 99) {
+               printf("Error: Cannot get valid round count.\n");
+               exit(-1);
+            }
+            break;
+         case 'o':
+            snprintf(benchdir, sizeof(benchdir), "%s", optarg);
+            break;
+         case 'h':
+            usage(); exit(0);
+         default:
+            usage(); exit(-1);
+      }
+   }
+}
+
+/* ------------------------------------------------------------ *
+ * bench() writes the files with one backend, returns seconds   *
+ * ------------------------------------------------------------ */
+double bench(int backend, const char *data, int *used) {
+   struct timespec a, b;
+   char fpath[512];
+   FILE *f;
+   int i, errors;
+
+   mkdir(benchdir, 0755);
+   clock_gettime(CLOCK_MONOTONIC, &a);
+   *used = awrite_init(backend);
+   for(i = 0; i < files; i++) {
+      snprintf(fpath, sizeof(fpath), "%s/%08d.bin", benchdir, i);
+      if(! (f = awrite_open(fpath))) {
+         printf("Error open %s for writing\n", fpath);
+         exit(-1);
+      }
+      fwrite(data, 1, filesize, f);
+      awrite_close(f);
+   }
+   errors = awrite_finish();
+   clock_gettime(CLOCK_MONOTONIC, &b);
+   if(errors > 0) {
+      printf("Error: %d files failed with %s\n", errors, awrite_name(*used));
+      exit(-1);
+   }
+
+   for(i = 0; i < files; i++) {
+      snprintf(fpath, sizeof(fpath), "%s/%08d.bin", benchdir, i);
+      unlink(fpath);
+   }
+   return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+}
+
+int cmp_double(const void *a, const void *b) {
+   double x = *(const double *) a, y = *(const double *) b;
+   return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[]) {
+   int backends[3] = { AWRITE_STDIO, AWRITE_THREADS, AWRITE_URING };
+   int used[3];
+   double secs[3][100], med;
+   char *data;
+   int b, r;
+
+   parseargs(argc, argv);
+   if(! (data = malloc(filesize + 1))) return -1;
+   for(b = 0; b < filesize; b++) data[b] = b % 251;
+
+   printf("awbench: %d files of %d bytes in %s, %d rounds\n", files, filesize, benchdir, rounds);
+   for(r = 0; r < rounds; r++) {
+      for(b = 0; b < 3; b++) {
+         int k = (b + r) % 3;
+         secs[k][r] = bench(backends[k], data, &used[k]);
+         if(verbose == 1) printf("Debug: round %d %s %.3fs\n", r, awrite_name(used[k]), secs[k][r]);
+      }
+   }
+   printf("backend      files    seconds    files/s       MB/s\n");
+   for(b = 0; b < 3; b++) {
+      qsort(secs[b], rounds, sizeof(double), cmp_double);
+      med = secs[b][rounds / 2];
+      printf("%-10s %7d %10.3f %10.0f %10.1f%s\n", awrite_name(used[b]), files, med,
+             files / med, (double) files * filesize / med / 1e6,
+             used[b] != backends[b] ? "  (uring not available)" : "");
+   }
+   rmdir(benchdir);
+   free(data);
+   return 0;
+}
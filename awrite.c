@@ -0,0 +1,413 @@
+/* ------------------------------------------------------------ *
+ * file:        awrite.c                                        *
+ * purpose:     day file writer backends, see awrite.h          *
+ *                                                              *
+ * A closed memory stream becomes a job: path, buffer, length. *
+ * The thread pool takes jobs from a bounded queue. io_uring   *
+ * gets three linked submissions per job: openat into a slot   *
+ * of a registered (direct) file table, write with that fixed  *
+ * file, close of the slot. The submissions go to the kernel   *
+ * in batches of AWURBATCH files, or when all slots are busy.  *
+ * The ring is set up with the raw system calls, there is no   *
+ * liburing dependency.                                         *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // malloc, free
+#include <stdio.h>     // open_memstream
+#include <string.h>    // strdup, strerror
+#include <stdint.h>    // uint64_t
+#include <unistd.h>    // write, close, syscall
+#include <fcntl.h>     // open flags, AT_FDCWD
+#include <errno.h>     // ECANCELED
+#include <pthread.h>   // thread pool
+#include <sys/mman.h>  // io_uring rings
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "awrite.h"
+
+#define AWOPEN 4                     // memory streams open at the same time
+#define AWQUEUE 256                  // thread pool queue length
+#define AWURBATCH 16                 // files per io_uring submit
+
+long awfiles = 0;                    // files written
+long awbytes = 0;                    // bytes written
+
+struct awjob {
+   char *path;                       // file to create
+   char *buf;                        // file content
+   size_t len;                       // content length
+   int pending;                      // io_uring completions outstanding
+   int failed;                       // error already reported
+};
+
+/* ------------------------------------------------------------ *
+ * the memory streams between awrite_open() and awrite_close()  *
+ * ------------------------------------------------------------ */
+static struct {
+   FILE *f;
+   char *buf;
+   size_t len;
+   char *path;
+} streams[AWOPEN];
+
+static int backend = AWRITE_STDIO;
+static int errors = 0;               // failed files
+
+/* ------------------------------------------------------------ *
+ * job_error() reports a failed file once                       *
+ * ------------------------------------------------------------ */
+static void job_error(struct awjob *j, const char *what, int err) {
+   if(j->failed) return;
+   j->failed = 1;
+   __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+   printf("Error %s %s: %s\n", what, j->path, strerror(err));
+}
+
+static void job_free(struct awjob *j) {
+   if(!j->failed) {
+      __atomic_add_fetch(&awfiles, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&awbytes, (long) j->len, __ATOMIC_RELAXED);
+   }
+   free(j->path);
+   free(j->buf);
+   free(j);
+}
+
+/* ------------------------------------------------------------ *
+ * thread pool: a ring of job pointers, workers take from tail  *
+ * ------------------------------------------------------------ */
+static struct awjob *queue[AWQUEUE];
+static int qhead = 0, qtail = 0, inflight = 0, quit = 0;
+static pthread_t workers[AWTHREADS];
+static pthread_mutex_t qlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t qmoved = PTHREAD_COND_INITIALIZER;
+
+static void write_job(struct awjob *j) {
+   size_t done = 0;
+   ssize_t n;
+   int fd;
+
+   if((fd = open(j->path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+      job_error(j, "open", errno);
+      return;
+   }
+   while(done < j->len) {
+      if((n = write(fd, j->buf + done, j->len - done)) < 0) {
+         if(errno == EINTR) continue;
+         job_error(j, "write", errno);
+         break;
+      }
+      done += n;
+   }
+   if(close(fd) != 0) job_error(j, "close", errno);
+}
+
+static void *worker(void *arg) {
+   struct awjob *j;
+
+   for(;;) {
+      pthread_mutex_lock(&qlock);
+      while(qhead == qtail && !quit) pthread_cond_wait(&qmoved, &qlock);
+      if(qhead == qtail) {
+         pthread_mutex_unlock(&qlock);
+         return NULL;
+      }
+      j = queue[qtail];
+      qtail = (qtail + 1) % AWQUEUE;
+      pthread_cond_broadcast(&qmoved);
+      pthread_mutex_unlock(&qlock);
+
+      write_job(j);
+      job_free(j);
+
+      pthread_mutex_lock(&qlock);
+      inflight--;
+      pthread_cond_broadcast(&qmoved);
+      pthread_mutex_unlock(&qlock);
+   }
+}
+
+static void pool_submit(struct awjob *j) {
+   pthread_mutex_lock(&qlock);
+   while((qhead + 1) % AWQUEUE == qtail) pthread_cond_wait(&qmoved, &qlock);
+   queue[qhead] = j;
+   qhead = (qhead + 1) % AWQUEUE;
+   inflight++;
+   pthread_cond_broadcast(&qmoved);
+   pthread_mutex_unlock(&qlock);
+}
+
+static int pool_start() {
+   int i;
+
+   quit = 0;
+   for(i = 0; i < AWTHREADS; i++)
+      if(pthread_create(&workers[i], NULL, worker, NULL) != 0) return -1;
+   return 0;
+}
+
+static void pool_drain() {
+   pthread_mutex_lock(&qlock);
+   while(inflight > 0) pthread_cond_wait(&qmoved, &qlock);
+   pthread_mutex_unlock(&qlock);
+}
+
+static void pool_stop() {
+   int i;
+
+   pthread_mutex_lock(&qlock);
+   while(inflight > 0) pthread_cond_wait(&qmoved, &qlock);
+   quit = 1;
+   pthread_cond_broadcast(&qmoved);
+   pthread_mutex_unlock(&qlock);
+   for(i = 0; i < AWTHREADS; i++) pthread_join(workers[i], NULL);
+}
+
+/* ------------------------------------------------------------ *
+ * io_uring: the rings are only used by the calling thread      *
+ * ------------------------------------------------------------ */
+static int ringfd = -1;
+static unsigned *sqhead, *sqtail, *sqmask, *sqarray, *cqhead, *cqtail, *cqmask;
+static struct io_uring_sqe *sqes;
+static struct io_uring_cqe *cqes;
+static void *sqring, *cqring;
+static size_t sqringsize, cqringsize, sqessize;
+static struct awjob *slots[AWURSLOTS];
+static int freeslots[AWURSLOTS], nfree = 0;
+static unsigned unsubmitted = 0;
+
+static int uring_enter(unsigned submit, unsigned wait) {
+   int n;
+
+   do n = syscall(__NR_io_uring_enter, ringfd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+   while(n < 0 && errno == EINTR);
+   if(n > 0) unsubmitted -= n;
+   return n;
+}
+
+static struct io_uring_sqe *uring_sqe() {
+   unsigned tail = *sqtail, i = tail & *sqmask;
+
+   sqarray[i] = i;
+   memset(&sqes[i], 0, sizeof(sqes[i]));
+   __atomic_store_n(sqtail, tail + 1, __ATOMIC_RELEASE);
+   unsubmitted++;
+   return &sqes[i];
+}
+
+/* ------------------------------------------------------------ *
+ * uring_reap() takes the completions, a job is done after its  *
+ * three. A failed openat cancels the linked write and close.   *
+ * ------------------------------------------------------------ */
+static void uring_reap() {
+   unsigned head = *cqhead, tail = __atomic_load_n(cqtail, __ATOMIC_ACQUIRE);
+   struct io_uring_cqe *c;
+   struct awjob *j;
+   int slot, op;
+
+   for(; head != tail; head++) {
+      c = &cqes[head & *cqmask];
+      slot = c->user_data >> 2;
+      op = c->user_data & 3;
+      j = slots[slot];
+      if(c->res < 0 && c->res != -ECANCELED) job_error(j, op == 0 ? "open" : op == 1 ? "write" : "close", -c->res);
+      else if(op == 1 && c->res >= 0 && (size_t) c->res != j->len) job_error(j, "write", EIO);
+      if(--j->pending == 0) {
+         job_free(j);
+         slots[slot] = NULL;
+         freeslots[nfree++] = slot;
+      }
+   }
+   __atomic_store_n(cqhead, head, __ATOMIC_RELEASE);
+}
+
+static void uring_prep(struct awjob *j, int slot) {
+   struct io_uring_sqe *s;
+
+   s = uring_sqe();
+   s->opcode     = IORING_OP_OPENAT;
+   s->fd         = AT_FDCWD;
+   s->addr       = (uint64_t) (uintptr_t) j->path;
+   s->len        = 0644;
+   s->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+   s->file_index = slot + 1;
+   s->flags      = IOSQE_IO_LINK;
+   s->user_data  = (uint64_t) slot << 2;
+
+   s = uring_sqe();
+   s->opcode     = IORING_OP_WRITE;
+   s->fd         = slot;
+   s->addr       = (uint64_t) (uintptr_t) j->buf;
+   s->len        = j->len;
+   s->off        = 0;
+   s->flags      = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+   s->user_data  = ((uint64_t) slot << 2) | 1;
+
+   s = uring_sqe();
+   s->opcode     = IORING_OP_CLOSE;
+   s->file_index = slot + 1;
+   s->user_data  = ((uint64_t) slot << 2) | 2;
+   j->pending = 3;
+}
+
+static void uring_submit(struct awjob *j) {
+   int slot;
+
+   while(nfree == 0) {
+      uring_enter(unsubmitted, 1);
+      uring_reap();
+   }
+   slot = freeslots[--nfree];
+   slots[slot] = j;
+   uring_prep(j, slot);
+   if(unsubmitted >= 3 * AWURBATCH) {
+      uring_enter(unsubmitted, 0);
+      uring_reap();
+   }
+}
+
+static void uring_unmap() {
+   munmap(sqes, sqessize);
+   if(cqring != sqring) munmap(cqring, cqringsize);
+   munmap(sqring, sqringsize);
+   close(ringfd);
+   ringfd = -1;
+}
+
+static void uring_drain() {
+   while(nfree < AWURSLOTS) {
+      uring_enter(unsubmitted, 1);
+      uring_reap();
+   }
+}
+
+static void uring_stop() {
+   uring_drain();
+   uring_unmap();
+}
+
+/* ------------------------------------------------------------ *
+ * uring_start() sets up the rings and the direct file table,   *
+ * then checks with a direct openat of "/" that the kernel can  *
+ * do what uring_prep() asks for. Returns -1 if not.            *
+ * ------------------------------------------------------------ */
+static int uring_start() {
+   struct io_uring_params p;
+   struct io_uring_sqe *s;
+   int fds[AWURSLOTS], i, ok;
+
+   memset(&p, 0, sizeof(p));
+   if((ringfd = syscall(__NR_io_uring_setup, 4 * AWURSLOTS, &p)) < 0) return -1;
+   sqringsize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+   cqringsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+   if(p.features & IORING_FEAT_SINGLE_MMAP) {
+      if(cqringsize > sqringsize) sqringsize = cqringsize;
+      cqringsize = sqringsize;
+   }
+   sqring = mmap(NULL, sqringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+   if(sqring == MAP_FAILED) { close(ringfd); return -1; }
+   cqring = sqring;
+   if(!(p.features & IORING_FEAT_SINGLE_MMAP))
+      cqring = mmap(NULL, cqringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+   sqessize = p.sq_entries * sizeof(struct io_uring_sqe);
+   sqes = mmap(NULL, sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+   if(cqring == MAP_FAILED || sqes == MAP_FAILED) { close(ringfd); return -1; }
+   sqhead  = (unsigned *) ((char *) sqring + p.sq_off.head);
+   sqtail  = (unsigned *) ((char *) sqring + p.sq_off.tail);
+   sqmask  = (unsigned *) ((char *) sqring + p.sq_off.ring_mask);
+   sqarray = (unsigned *) ((char *) sqring + p.sq_off.array);
+   cqhead  = (unsigned *) ((char *) cqring + p.cq_off.head);
+   cqtail  = (unsigned *) ((char *) cqring + p.cq_off.tail);
+   cqmask  = (unsigned *) ((char *) cqring + p.cq_off.ring_mask);
+   cqes    = (struct io_uring_cqe *) ((char *) cqring + p.cq_off.cqes);
+
+   for(i = 0; i < AWURSLOTS; i++) fds[i] = -1;
+   if(syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_FILES, fds, AWURSLOTS) < 0) {
+      uring_unmap();
+      return -1;
+   }
+
+   s = uring_sqe();
+   s->opcode     = IORING_OP_OPENAT;
+   s->fd         = AT_FDCWD;
+   s->addr       = (uint64_t) (uintptr_t) "/";
+   s->open_flags = O_RDONLY | O_DIRECTORY;
+   s->file_index = 1;
+   s->flags      = IOSQE_IO_LINK;
+   s = uring_sqe();
+   s->opcode     = IORING_OP_CLOSE;
+   s->file_index = 1;
+   s->user_data  = 1;
+   uring_enter(2, 2);
+   ok = __atomic_load_n(cqtail, __ATOMIC_ACQUIRE) - *cqhead == 2 &&
+        cqes[*cqhead & *cqmask].res == 0 && cqes[(*cqhead + 1) & *cqmask].res == 0;
+   __atomic_store_n(cqhead, *cqhead + 2, __ATOMIC_RELEASE);
+   unsubmitted = 0;
+   if(!ok) {
+      uring_unmap();
+      return -1;
+   }
+   nfree = AWURSLOTS;
+   for(i = 0; i < AWURSLOTS; i++) freeslots[i] = AWURSLOTS - 1 - i;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * the interface, see awrite.h                                  *
+ * ------------------------------------------------------------ */
+const char *awrite_name(int b) {
+   return b == AWRITE_URING ? "uring" : b == AWRITE_THREADS ? "threads" : "stdio";
+}
+
+int awrite_init(int b) {
+   errors = 0;
+   awfiles = awbytes = 0;
+   backend = b;
+   if(backend == AWRITE_URING && uring_start() != 0) backend = AWRITE_THREADS;
+   if(backend == AWRITE_THREADS && pool_start() != 0) backend = AWRITE_STDIO;
+   return backend;
+}
+
+FILE *awrite_open(const char *path) {
+   int i;
+
+   if(backend == AWRITE_STDIO) return fopen(path, "w");
+   for(i = 0; i < AWOPEN && streams[i].f; i++);
+   if(i == AWOPEN || !(streams[i].path = strdup(path))) return NULL;
+   if(!(streams[i].f = open_memstream(&streams[i].buf, &streams[i].len))) free(streams[i].path);
+   return streams[i].f;
+}
+
+int awrite_close(FILE *f) {
+   struct awjob *j;
+   int i;
+
+   if(backend == AWRITE_STDIO) {
+      awbytes += ftell(f);
+      awfiles++;
+      return fclose(f);
+   }
+   for(i = 0; i < AWOPEN && streams[i].f != f; i++);
+   if(i == AWOPEN) return -1;
+   fclose(f);
+   streams[i].f = NULL;
+   if(!(j = calloc(1, sizeof(*j)))) return -1;
+   j->path = streams[i].path;
+   j->buf = streams[i].buf;
+   j->len = streams[i].len;
+   if(backend == AWRITE_URING) uring_submit(j);
+   else pool_submit(j);
+   return __atomic_load_n(&errors, __ATOMIC_RELAXED) ? -1 : 0;
+}
+
+int awrite_sync(void) {
+   if(backend == AWRITE_URING) uring_drain();
+   if(backend == AWRITE_THREADS) pool_drain();
+   return errors;
+}
+
+int awrite_finish(void) {
+   if(backend == AWRITE_URING) uring_stop();
+   if(backend == AWRITE_THREADS) pool_stop();
+   backend = AWRITE_STDIO;
+   return errors;
+}
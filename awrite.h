@@ -0,0 +1,50 @@
+/* ------------------------------------------------------------ *
+ * file:        awrite.h                                        *
+ * purpose:     day file writer backends for suncalc -w: files  *
+ *              are built in memory and written as one open,    *
+ *              write, close each, by a thread pool or batched  *
+ *              through io_uring, while the next day is encoded.*
+ * ------------------------------------------------------------ */
+#ifndef AWRITE_H
+#define AWRITE_H
+
+#include <stdio.h>
+
+#define AWRITE_STDIO   0             // fopen, fwrite, fclose in the caller (default)
+#define AWRITE_THREADS 1             // thread pool of AWTHREADS writers
+#define AWRITE_URING   2             // io_uring, linked openat, write, close
+
+#define AWTHREADS 4                  // thread pool size
+#define AWURSLOTS 64                 // io_uring files in flight
+
+/* ------------------------------------------------------------ *
+ * awrite_init() starts a backend, AWRITE_URING falls back to   *
+ * AWRITE_THREADS if the kernel has no io_uring, or no direct  *
+ * descriptors for openat (Linux < 5.15). Returns the backend  *
+ * in use. awrite_name() is its name.                           *
+ * ------------------------------------------------------------ */
+int awrite_init(int backend);
+const char *awrite_name(int backend);
+
+/* ------------------------------------------------------------ *
+ * awrite_open() returns a FILE that creates the file path when *
+ * given to awrite_close(). With AWRITE_STDIO this is fopen()  *
+ * and fclose(), otherwise the FILE is a memory stream and the *
+ * file is written later. Its write errors are printed, and    *
+ * make awrite_close() and awrite_finish() return nonzero.      *
+ * ------------------------------------------------------------ */
+FILE *awrite_open(const char *path);
+int awrite_close(FILE *f);
+
+/* ------------------------------------------------------------ *
+ * awrite_sync() waits until all files given to awrite_close()  *
+ * are written, awrite_finish() also stops the backend. Both    *
+ * return the number of files that failed so far. awfiles and  *
+ * awbytes count the files and bytes written.                   *
+ * ------------------------------------------------------------ */
+int awrite_sync(void);
+int awrite_finish(void);
+extern long awfiles;
+extern long awbytes;
+
+#endif
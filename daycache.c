@@ -0,0 +1,182 @@
+/* ------------------------------------------------------------ *
+ * file:        daycache.c                                      *
+ * purpose:     content addressed day file cache, see daycache.h *
+ *                                                              *
+ * A cached file is dir/hh/hhhhhhhhhhhhhhhh.ext, the 64 bit    *
+ * FNV-1a hash of the params text and the date, with the first *
+ * byte as subfolder. The dates only differ in the last bytes, *
+ * a final mix step spreads them over the subfolders.          *
+ *                                                              *
+ * A file enters the cache as a hard link of the dataset file, *
+ * so the cache and all datasets that use a day share one copy *
+ * on disk. Dataset files are never written in place, suncalc  *
+ * removes and recreates them, which keeps the cached copy     *
+ * intact. Where hard links fail, e.g. across file systems or  *
+ * at the link count limit, the file is copied, with a reflink *
+ * if the file system can.                                      *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // malloc, realloc
+#include <stdio.h>     // snprintf, error output
+#include <string.h>    // strdup, strerror
+#include <stdint.h>    // uint64_t
+#include <unistd.h>    // link, read, write
+#include <fcntl.h>     // open flags
+#include <errno.h>     // EEXIST, EXDEV
+#include <sys/stat.h>  // mkdir, stat
+#include <sys/ioctl.h> // FICLONE
+#include <linux/fs.h>
+#include "daycache.h"
+
+long dcfiles = 0;                    // files taken from the cache
+long dcbytes = 0;                    // bytes taken from the cache
+long dccopies = 0;                   // taken files that are copies
+long dcstored = 0;                   // files added to the cache
+
+static char cachedir[256];
+static char *params;
+
+/* ------------------------------------------------------------ *
+ * the files to store by daycache_close()                       *
+ * ------------------------------------------------------------ */
+static struct dcnew {
+   char *cpath;
+   char *fpath;
+} *added;
+static int nadded = 0;
+static int maxadded = 0;
+
+/* ------------------------------------------------------------ *
+ * cache_path() returns the cache file path for date and ext    *
+ * ------------------------------------------------------------ */
+static void cache_path(char *cpath, size_t len, const char *date, const char *ext) {
+   uint64_t h = 14695981039346656037ULL;
+   const char *p;
+
+   for(p = params; *p; p++) h = (h ^ (uint8_t) *p) * 1099511628211ULL;
+   h = (h ^ '|') * 1099511628211ULL;
+   for(p = date; *p; p++) h = (h ^ (uint8_t) *p) * 1099511628211ULL;
+   h ^= h >> 33;                     // mix the last bytes into the high ones
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+   snprintf(cpath, len, "%s/%02x/%016llx.%s", cachedir, (unsigned) (h >> 56),
+            (unsigned long long) h, ext);
+}
+
+/* ------------------------------------------------------------ *
+ * copy_file() creates dst as a copy of src, returns 0 or errno *
+ * ------------------------------------------------------------ */
+static int copy_file(const char *src, const char *dst) {
+   char buf[65536];
+   ssize_t n = 0;
+   int in, out, err = 0;
+
+   if((in = open(src, O_RDONLY)) < 0) return errno;
+   if((out = open(dst, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
+      err = errno;
+      close(in);
+      return err;
+   }
+   if(ioctl(out, FICLONE, in) != 0) {
+      while((n = read(in, buf, sizeof(buf))) > 0)
+         if(write(out, buf, n) != n) break;
+      if(n != 0) err = errno ? errno : EIO;
+   }
+   close(in);
+   if(close(out) != 0 && err == 0) err = errno;
+   if(err != 0) unlink(dst);
+   return err;
+}
+
+int daycache_open(const char *dir, const char *text) {
+   struct stat st;
+
+   if(mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+   if(stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) return -1;
+   snprintf(cachedir, sizeof(cachedir), "%s", dir);
+   free(params);
+   params = strdup(text);
+   return params ? 0 : -1;
+}
+
+int daycache_has(const char *date, const char *ext) {
+   char cpath[512];
+
+   cache_path(cpath, sizeof(cpath), date, ext);
+   return access(cpath, R_OK) == 0;
+}
+
+int daycache_link(const char *date, const char *ext, const char *fpath) {
+   char cpath[512];
+   struct stat st;
+   int err = 0;
+
+   cache_path(cpath, sizeof(cpath), date, ext);
+   unlink(fpath);
+   if(link(cpath, fpath) != 0) {
+      if((err = copy_file(cpath, fpath)) != 0) {
+         printf("Error link %s from cache %s: %s\n", fpath, cpath, strerror(err));
+         return -1;
+      }
+      dccopies++;
+   }
+   if(stat(fpath, &st) == 0) dcbytes += st.st_size;
+   dcfiles++;
+   return 0;
+}
+
+void daycache_add(const char *date, const char *ext, const char *fpath) {
+   char cpath[512];
+   struct dcnew *grow;
+
+   if(nadded == maxadded) {
+      maxadded = maxadded ? 2 * maxadded : 1024;
+      if(!(grow = realloc(added, maxadded * sizeof(*added)))) {
+         printf("Error: out of memory for the cache file list\n");
+         exit(-1);
+      }
+      added = grow;
+   }
+   cache_path(cpath, sizeof(cpath), date, ext);
+   added[nadded].cpath = strdup(cpath);
+   added[nadded].fpath = strdup(fpath);
+   nadded++;
+}
+
+/* ------------------------------------------------------------ *
+ * daycache_close() stores the new files. A copy goes to a temp *
+ * file first, so a reader never sees a partial cache file.    *
+ * Another run that stored the same file first wins.            *
+ * ------------------------------------------------------------ */
+int daycache_close(void) {
+   char tpath[544], *slash;
+   int i, err, errors = 0;
+
+   for(i = 0; i < nadded; i++) {
+      slash = strrchr(added[i].cpath, '/');
+      *slash = '\0';
+      mkdir(added[i].cpath, 0755);
+      *slash = '/';
+      err = 0;
+      if(link(added[i].fpath, added[i].cpath) == 0) dcstored++;
+      else if(errno != EEXIST) {
+         snprintf(tpath, sizeof(tpath), "%s.%d", added[i].cpath, (int) getpid());
+         if((err = copy_file(added[i].fpath, tpath)) == 0) {
+            if(rename(tpath, added[i].cpath) == 0) dcstored++;
+            else {
+               err = errno;
+               unlink(tpath);
+            }
+         }
+      }
+      if(err != 0) {
+         printf("Error store %s in cache %s: %s\n", added[i].fpath, added[i].cpath, strerror(err));
+         errors++;
+      }
+      free(added[i].cpath);
+      free(added[i].fpath);
+   }
+   free(added);
+   added = NULL;
+   nadded = maxadded = 0;
+   return errors;
+}
@@ -0,0 +1,49 @@
+/* ------------------------------------------------------------ *
+ * file:        daycache.h                                      *
+ * purpose:     content addressed day file cache for suncalc    *
+ *              --cachedir: day files are stored under a hash   *
+ *              of their inputs, and linked into later datasets *
+ *              with the same inputs instead of calculated.     *
+ * ------------------------------------------------------------ */
+#ifndef DAYCACHE_H
+#define DAYCACHE_H
+
+/* ------------------------------------------------------------ *
+ * daycache_open() uses the folder dir as cache, creating it if *
+ * needed. params is the text of all inputs of a day file but  *
+ * the date: program and engine version, site, timezone,       *
+ * interval and file layout. Returns 0, or -1 if dir is not a  *
+ * usable folder.                                               *
+ * ------------------------------------------------------------ */
+int daycache_open(const char *dir, const char *params);
+
+/* ------------------------------------------------------------ *
+ * daycache_has() returns 1 if the cache has the file with the  *
+ * extension ext for the date yyyymmdd, else 0.                 *
+ * daycache_link() creates fpath from the cache: a hard link,  *
+ * a reflink copy if the output is on another file system, or  *
+ * a plain copy, an existing fpath is replaced. Returns 0, or  *
+ * -1 after printing the error.                                 *
+ * ------------------------------------------------------------ */
+int daycache_has(const char *date, const char *ext);
+int daycache_link(const char *date, const char *ext, const char *fpath);
+
+/* ------------------------------------------------------------ *
+ * daycache_add() notes the new file fpath for the cache, which *
+ * daycache_close() stores once all files are written. It       *
+ * returns the number of files that failed.                     *
+ * ------------------------------------------------------------ */
+void daycache_add(const char *date, const char *ext, const char *fpath);
+int daycache_close(void);
+
+/* ------------------------------------------------------------ *
+ * dcfiles and dcbytes count the files and bytes taken from the *
+ * cache, dccopies the ones that had to be copied, dcstored the *
+ * files added to it.                                           *
+ * ------------------------------------------------------------ */
+extern long dcfiles;
+extern long dcbytes;
+extern long dccopies;
+extern long dcstored;
+
+#endif
@@ -0,0 +1,467 @@
+/* ------------------------------------------------------------ *
+ * file:        filter.c                                        *
+ * purpose:     timestamp filter for suncalc --filter, see      *
+ *              filter.h                                        *
+ *                                                              *
+ * Three stages work on a ring of FSLOTS batches, so reading,   *
+ * computing and writing overlap: the read thread fills a slot *
+ * from stdin and parses the times, the calling thread looks   *
+ * up the positions and formats the csv lines, and the write   *
+ * thread sends them to stdout. A slot goes FREE -> PARSED ->  *
+ * DONE -> FREE, each stage takes the slots in ring order.     *
+ * The positions come from day tables in a small cache, so a   *
+ * timestamp costs an index lookup and an interpolation, not a *
+ * SPA calculation. Telemetry times cluster on few days.       *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // malloc
+#include <stdio.h>     // fprintf
+#include <stdint.h>    // int64_t data type
+#include <string.h>    // memcpy, memchr
+#include <unistd.h>    // read, write, dup
+#include <errno.h>     // EINTR
+#include <signal.h>    // SIGPIPE
+#include <pthread.h>   // read and write threads
+#include <time.h>      // mktime, stage timing
+#include "libsuncalc.h" // dataset generator
+#include "filter.h"
+
+#define FSLOTS 4                     // batches in the ring
+#define FROWS  65536                 // timestamps per batch
+#define FTEXT  (FROWS * 8)           // input bytes per batch, one batch of int64
+#define FTOKEN 40                    // longest time text copied to the output
+#define FLINE  (FTOKEN + 32)         // longest output line
+#define FCACHE 16                    // cached day tables, about 40KB each
+
+enum { SLOT_FREE, SLOT_PARSED, SLOT_DONE };
+
+/* ------------------------------------------------------------ *
+ * fslot is one batch: the input bytes, the parsed times, and   *
+ * the output lines. Text input keeps the position and length  *
+ * of each time in text, it is copied to the output as given.  *
+ * ------------------------------------------------------------ */
+struct fslot {
+   int state;                        // SLOT_FREE, SLOT_PARSED or SLOT_DONE
+   int rows;                         // timestamps in the batch
+   int last;                         // 1 = the batch ends the input
+   size_t textlen;                   // bytes in text
+   size_t outlen;                    // bytes in out
+   int64_t time[FROWS];              // unix time in seconds
+   uint8_t valid[FROWS];             // 0 = the time could not be parsed
+   uint32_t tokpos[FROWS];           // text input: time position in text
+   uint8_t toklen[FROWS];            // text input: time length
+   char text[FTEXT];                 // input bytes
+   char out[FROWS * FLINE];          // csv output lines
+};
+
+/* ------------------------------------------------------------ *
+ * fday is one cached day table, from 00:00 local time until    *
+ * 00:00 of the next day, which is appended as the last record *
+ * so the last minutes of the day interpolate too.             *
+ * ------------------------------------------------------------ */
+struct fday {
+   time_t start;                     // 00:00 local time
+   time_t end;                       // 00:00 of the next day
+   unsigned long lastuse;            // use counter of the last hit, 0 = free
+   struct dayset day;                // the day table
+};
+
+static struct fslot *slots = NULL;   // the batch ring
+static struct fday *days = NULL;     // the day table cache
+static struct sungen *gen = NULL;    // generator for day tables
+static unsigned long usecount = 0;   // cache use counter
+static int binary = 0;               // 1 = packed int64 input
+static int outfd = -1;               // data output, the original stdout
+static int failed = 0;               // read or write error, stops all stages
+static long rows = 0, invalid = 0, calcdays = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t moved = PTHREAD_COND_INITIALIZER;
+
+/* ------------------------------------------------------------ *
+ * wait_slot() waits until slot s reaches state, returns -1 if  *
+ * another stage failed. set_slot() hands the slot on.          *
+ * ------------------------------------------------------------ */
+static int wait_slot(struct fslot *s, int state) {
+   pthread_mutex_lock(&lock);
+   while(s->state != state && !failed) pthread_cond_wait(&moved, &lock);
+   pthread_mutex_unlock(&lock);
+   return failed ? -1 : 0;
+}
+
+static void set_slot(struct fslot *s, int state) {
+   pthread_mutex_lock(&lock);
+   s->state = state;
+   pthread_cond_broadcast(&moved);
+   pthread_mutex_unlock(&lock);
+}
+
+static void fail() {
+   pthread_mutex_lock(&lock);
+   failed = 1;
+   pthread_cond_broadcast(&moved);
+   pthread_mutex_unlock(&lock);
+}
+
+/* ------------------------------------------------------------ *
+ * civil_days() returns the days since 1970-01-01 of a date in  *
+ * the proleptic Gregorian calendar                             *
+ * ------------------------------------------------------------ */
+static int64_t civil_days(int y, int m, int d) {
+   int64_t era;
+   int yoe, doy, doe;
+
+   y -= m <= 2;
+   era = (y >= 0 ? y : y - 399) / 400;
+   yoe = y - era * 400;
+   doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+   doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+   return era * 146097 + doe - 719468;
+}
+
+/* ------------------------------------------------------------ *
+ * digits() reads n decimal digits at p, -1 if there are less   *
+ * ------------------------------------------------------------ */
+static int digits(const char *p, const char *end, int n) {
+   int v = 0;
+
+   if(end - p < n) return -1;
+   while(n-- > 0) {
+      if(*p < '0' || *p > '9') return -1;
+      v = v * 10 + (*p++ - '0');
+   }
+   return v;
+}
+
+/* ------------------------------------------------------------ *
+ * parse_time() converts unix seconds, or ISO-8601 as           *
+ * yyyy-mm-ddThh:mm[:ss[.fff]][Z|+hh:mm|-hh:mm], to unix time.  *
+ * ISO times without zone are local time of the process (TZ),  *
+ * like the data files. mktime() is only called when the hour  *
+ * changes. Returns 0, or -1 for an invalid time.               *
+ * ------------------------------------------------------------ */
+static int parse_time(const char *p, const char *end, int64_t *t) {
+   static int lastkey = -1;
+   static time_t lastbase = 0;
+   int y, mo, d, h, mi, s = 0, zone = 0, utc = 0, key;
+   int64_t v = 0;
+
+   if(end - p <= 4 || p[4] != '-') {  // unix seconds, a fraction is cut off
+      if(p == end || *p < '0' || *p > '9') return -1;
+      while(p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+      if(p < end && *p == '.') while(++p < end && *p >= '0' && *p <= '9');
+      if(p != end) return -1;
+      *t = v;
+      return 0;
+   }
+   if((y = digits(p, end, 4)) < 0 || end - p < 16 || p[4] != '-' || p[7] != '-' ||
+      (p[10] != 'T' && p[10] != ' ') || p[13] != ':') return -1;
+   if((mo = digits(p + 5, end, 2)) < 1 || mo > 12 || (d = digits(p + 8, end, 2)) < 1 || d > 31 ||
+      (h = digits(p + 11, end, 2)) < 0 || h > 23 || (mi = digits(p + 14, end, 2)) < 0 || mi > 59) return -1;
+   p += 16;
+   if(p < end && *p == ':') {
+      if((s = digits(p + 1, end, 2)) < 0 || s > 60) return -1;
+      p += 3;
+      if(p < end && *p == '.') while(++p < end && *p >= '0' && *p <= '9');
+   }
+   if(p < end && *p == 'Z') { utc = 1; p++; }
+   else if(p < end && (*p == '+' || *p == '-')) {
+      int zh = digits(p + 1, end, 2), zm = 0;
+      const char *q = p + 3;
+      if(zh < 0) return -1;
+      if(q < end && *q == ':') q++;
+      if(q < end && (zm = digits(q, end, 2)) < 0) return -1;
+      if(q < end) q += 2;
+      zone = (zh * 3600 + zm * 60) * (*p == '-' ? -1 : 1);
+      utc = 1;
+      p = q;
+   }
+   if(p != end) return -1;
+
+   if(utc) {
+      *t = civil_days(y, mo, d) * 86400 + h * 3600 + mi * 60 + s - zone;
+      return 0;
+   }
+   key = ((y * 100 + mo) * 100 + d) * 100 + h;
+   if(key != lastkey) {
+      struct tm tm = { .tm_year = y - 1900, .tm_mon = mo - 1, .tm_mday = d,
+                       .tm_hour = h, .tm_isdst = -1 };
+      lastbase = mktime(&tm);
+      lastkey = key;
+   }
+   *t = lastbase + mi * 60 + s;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * parse_slot() parses the input bytes of a slot into times.    *
+ * Returns the number of bytes at the end that belong to the   *
+ * next batch: a line without newline yet, or a partial int64. *
+ * ------------------------------------------------------------ */
+static size_t parse_slot(struct fslot *sl) {
+   const char *p = sl->text, *end = sl->text + sl->textlen, *nl, *e;
+
+   sl->rows = 0;
+   if(binary) {
+      sl->rows = sl->textlen / 8;
+      memcpy(sl->time, sl->text, sl->rows * 8);
+      memset(sl->valid, 1, sl->rows);
+      return sl->textlen % 8;
+   }
+   while(p < end && sl->rows < FROWS) {
+      if(!(nl = memchr(p, '\n', end - p))) {
+         if(!sl->last && p > sl->text) break;
+         nl = end;                    // the input ends without newline, or the line fills the batch
+      }
+      e = nl;
+      while(e > p && (e[-1] == '\r' || e[-1] == ' ')) e--;
+      while(p < e && *p == ' ') p++;
+      if(e > p) {
+         sl->valid[sl->rows] = parse_time(p, e, &sl->time[sl->rows]) == 0;
+         sl->tokpos[sl->rows] = p - sl->text;
+         sl->toklen[sl->rows] = e - p > FTOKEN ? FTOKEN : e - p;
+         sl->rows++;
+      }
+      p = nl < end ? nl + 1 : end;
+   }
+   return end - p;
+}
+
+/* ------------------------------------------------------------ *
+ * read_thread() is the read stage: fill, parse, hand on        *
+ * ------------------------------------------------------------ */
+static void *read_thread(void *arg) {
+   static char carry[FTEXT];
+   size_t carrylen = 0;
+   ssize_t n;
+   int i = 0, last;
+   struct fslot *sl;
+
+   do {
+      sl = &slots[i];
+      if(wait_slot(sl, SLOT_FREE) < 0) return NULL;
+      memcpy(sl->text, carry, carrylen);
+      sl->textlen = carrylen;
+      sl->last = 0;
+      while(sl->textlen < FTEXT) {
+         n = read(STDIN_FILENO, sl->text + sl->textlen, FTEXT - sl->textlen);
+         if(n < 0 && errno == EINTR) continue;
+         if(n < 0) {
+            fprintf(stderr, "Error: cannot read stdin.\n");
+            fail();
+            return NULL;
+         }
+         if(n == 0) { sl->last = 1; break; }
+         sl->textlen += n;
+      }
+      carrylen = parse_slot(sl);
+      if(sl->last && carrylen > 0) {
+         if(binary) {
+            fprintf(stderr, "Error: input ends with a partial int64, %d bytes ignored.\n", (int) carrylen);
+            carrylen = 0;
+         }
+         else sl->last = 0;           // the batch is full, the rest goes into the next one
+      }
+      memcpy(carry, sl->text + sl->textlen - carrylen, carrylen);
+      last = sl->last;
+      set_slot(sl, SLOT_PARSED);
+      i = (i + 1) % FSLOTS;
+   } while(!last);
+   return NULL;
+}
+
+/* ------------------------------------------------------------ *
+ * write_thread() is the write stage                            *
+ * ------------------------------------------------------------ */
+static void *write_thread(void *arg) {
+   struct fslot *sl;
+   size_t done;
+   ssize_t n;
+   int i = 0, last;
+
+   do {
+      sl = &slots[i];
+      if(wait_slot(sl, SLOT_DONE) < 0) return NULL;
+      for(done = 0; done < sl->outlen; done += n) {
+         n = write(outfd, sl->out + done, sl->outlen - done);
+         if(n < 0 && errno == EINTR) { n = 0; continue; }
+         if(n < 0) {
+            fprintf(stderr, "Error: cannot write stdout.\n");
+            fail();
+            return NULL;
+         }
+      }
+      last = sl->last;
+      set_slot(sl, SLOT_FREE);
+      i = (i + 1) % FSLOTS;
+   } while(!last);
+   return NULL;
+}
+
+/* ------------------------------------------------------------ *
+ * add_day() is the generator sink: the first day is the table, *
+ * the first record of the next day is appended to it          *
+ * ------------------------------------------------------------ */
+static int add_day(void *ctx, const struct dayset *d) {
+   struct dayset *t = &((struct fday *) ctx)->day;
+
+   if(t->rows == 0) memcpy(t, d, sizeof(*d));
+   else if(t->rows < MAXROWS && d->rows > 0) {
+      t->time[t->rows]    = d->time[0];
+      t->hour[t->rows]    = d->hour[0];
+      t->minute[t->rows]  = d->minute[0];
+      t->dflag[t->rows]   = d->dflag[0];
+      t->azimuth[t->rows] = d->azimuth[0];
+      t->zenith[t->rows]  = d->zenith[0];
+      t->rows++;
+   }
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * find_day() returns the day table for time t, from the cache  *
+ * or calculated into the least recently used entry            *
+ * ------------------------------------------------------------ */
+static struct fday *find_day(const struct sunconf *conf, time_t t) {
+   static struct fday *cur = NULL;
+   struct sunconf c = *conf;
+   struct sunsink sink = { NULL, NULL, add_day, NULL };
+   struct tm tm;
+   int i;
+
+   if(cur && t >= cur->start && t < cur->end) return cur;
+   for(i = 0; i < FCACHE; i++) {
+      if(days[i].lastuse > 0 && t >= days[i].start && t < days[i].end) {
+         cur = &days[i];
+         cur->lastuse = ++usecount;
+         return cur;
+      }
+   }
+   cur = &days[0];
+   for(i = 1; i < FCACHE; i++) if(days[i].lastuse < cur->lastuse) cur = &days[i];
+
+   localtime_r(&t, &tm);
+   tm.tm_hour  = 0;
+   tm.tm_min   = 0;
+   tm.tm_sec   = 0;
+   tm.tm_isdst = -1;
+   cur->start = mktime(&tm);
+   tm.tm_mday += 1;
+   tm.tm_isdst = -1;
+   cur->end = mktime(&tm);
+   cur->lastuse = ++usecount;
+   cur->day.rows = 0;
+   c.start = cur->start;
+   c.end   = cur->end + c.interval;
+   sink.ctx = cur;
+   sungen_init(gen, &c);
+   sungen_sink(gen, &sink);
+   sungen_run(gen);
+   calcdays++;
+   return cur;
+}
+
+/* ------------------------------------------------------------ *
+ * fix3() writes v with 3 decimals, as printf %.3f does, but    *
+ * without the printf cost per row                              *
+ * ------------------------------------------------------------ */
+static char *fix3(char *p, double v) {
+   char tmp[24];
+   long m;
+   int n = 0;
+
+   if(v < 0) { *p++ = '-'; v = -v; }
+   m = (long) (v * 1000 + 0.5);
+   tmp[n++] = '0' + m % 10; m /= 10;
+   tmp[n++] = '0' + m % 10; m /= 10;
+   tmp[n++] = '0' + m % 10; m /= 10;
+   tmp[n++] = '.';
+   do { tmp[n++] = '0' + m % 10; m /= 10; } while(m > 0);
+   while(n > 0) *p++ = tmp[--n];
+   return p;
+}
+
+/* ------------------------------------------------------------ *
+ * compute_slot() is the compute stage: look up the position of *
+ * each time and write the csv line, invalid times get empty   *
+ * fields so the output lines stay aligned with the input.     *
+ * ------------------------------------------------------------ */
+static void compute_slot(const struct sunconf *conf, struct fslot *sl) {
+   char *o = sl->out;
+   double az, ze;
+   int r, dflag;
+
+   for(r = 0; r < sl->rows; r++) {
+      if(binary) o += sprintf(o, "%lld", (long long) sl->time[r]);
+      else {
+         memcpy(o, sl->text + sl->tokpos[r], sl->toklen[r]);
+         o += sl->toklen[r];
+      }
+      if(!sl->valid[r]) {
+         memcpy(o, ",,,\n", 4);
+         o += 4;
+         invalid++;
+         continue;
+      }
+      dflag = sun_dayposition(&find_day(conf, sl->time[r])->day, sl->time[r], &az, &ze);
+      *o++ = ',';
+      *o++ = '0' + dflag;
+      *o++ = ',';
+      o = fix3(o, az);
+      *o++ = ',';
+      o = fix3(o, ze);
+      *o++ = '\n';
+   }
+   rows += sl->rows;
+   sl->outlen = o - sl->out;
+}
+
+/* ------------------------------------------------------------ *
+ * filter_run() starts the read and write threads and runs the  *
+ * compute stage                                                *
+ * ------------------------------------------------------------ */
+int filter_run(const char *mode, const struct sunconf *conf) {
+   struct timespec a, b;
+   pthread_t reader, writer;
+   struct fslot *sl;
+   double secs;
+   int i = 0, last = 0;
+
+   binary = strcmp(mode, "bin") == 0;
+   slots = calloc(FSLOTS, sizeof(struct fslot));
+   days = calloc(FCACHE, sizeof(struct fday));
+   gen = malloc(sizeof(struct sungen));
+   if(!slots || !days || !gen) {
+      fprintf(stderr, "Error: cannot allocate the filter buffers.\n");
+      return -1;
+   }
+
+   /* -------------------------------------------------------- *
+    * stdout is for data only, messages go to stderr           *
+    * -------------------------------------------------------- */
+   signal(SIGPIPE, SIG_IGN);
+   outfd = dup(STDOUT_FILENO);
+   dup2(STDERR_FILENO, STDOUT_FILENO);
+
+   clock_gettime(CLOCK_MONOTONIC, &a);
+   pthread_create(&reader, NULL, read_thread, NULL);
+   pthread_create(&writer, NULL, write_thread, NULL);
+   while(!last) {
+      sl = &slots[i];
+      if(wait_slot(sl, SLOT_PARSED) < 0) break;
+      compute_slot(conf, sl);
+      last = sl->last;
+      set_slot(sl, SLOT_DONE);
+      i = (i + 1) % FSLOTS;
+   }
+   pthread_join(writer, NULL);
+   if(!failed) pthread_join(reader, NULL); // else it may still wait in read()
+   clock_gettime(CLOCK_MONOTONIC, &b);
+   close(outfd);
+
+   secs = (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+   fprintf(stderr, "Filter rows [%ld] invalid [%ld] day tables [%ld] time [%.3f s] rate [%.0f rows/s]\n",
+           rows, invalid, calcdays, secs, secs > 0 ? rows / secs : 0);
+   free(gen);
+   free(days);
+   free(slots);
+   return failed ? -1 : 0;
+}
@@ -0,0 +1,23 @@
+/* ------------------------------------------------------------ *
+ * file:        filter.h                                        *
+ * purpose:     timestamp filter for suncalc --filter, reads    *
+ *              times from stdin and writes the sun position    *
+ *              for each of them to stdout.                     *
+ * ------------------------------------------------------------ */
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "libsuncalc.h"
+
+/* ------------------------------------------------------------ *
+ * filter_run() reads timestamps from stdin until EOF: with     *
+ * mode "text" one per line, as unix seconds or ISO-8601, with  *
+ * mode "bin" as packed native int64 unix seconds. It writes    *
+ * one csv line time,dflag,azimuth,zenith per timestamp to      *
+ * stdout, interpolated from day tables of conf->interval, and  *
+ * the totals to stderr. Returns 0, or -1 on a read or write    *
+ * error.                                                       *
+ * ------------------------------------------------------------ */
+int filter_run(const char *mode, const struct sunconf *conf);
+
+#endif
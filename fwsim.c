@@ -0,0 +1,554 @@
+/* ------------------------------------------------------------ *
+ * file:        fwsim.c                                         *
+ * purpose:     simulate the tracker MCU read path on a suncalc *
+ *              dataset, and count the SD card I/O per day.     *
+ *                                                              *
+ * return:      0 on success, and -1 on errors.                 *
+ *                                                              *
+ * example:	./fwsim -d ./tracker-data                       *
+ *                                                              *
+ * fwsim reads dset.txt, then replays the access pattern of the *
+ * tracker for every day of the dataset: open the day file,    *
+ * seek and read the record for each tracking cycle, and read  *
+ * the srs record once per day. The files are read for real,  *
+ * the I/O cost is counted as the MKR Zero SD library has it:  *
+ * sector reads      -> 512 byte sector transfers, with the one *
+ *                      sector read cache of the SD library    *
+ * split records     -> record reads crossing a sector boundary *
+ * dir entries       -> FAT folder entries scanned on file open *
+ * cluster hops      -> FAT chain steps to seek in an open file *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // various, atoi
+#include <limits.h>    // LONG_MAX
+#include <stdio.h>     // run display
+#include <stdint.h>    // uint8_t data type
+#include <string.h>    // string handling
+#include <dirent.h>    // folder listing
+#include <fcntl.h>     // open
+#include <unistd.h>    // pread, getopt
+#include <getopt.h>    // arg handling
+#include <sys/stat.h>  // file size
+#include <time.h>      // date calculation
+#include "sunread.h"   // data file reader functions
+
+#define SECTOR 512
+
+/* ------------------------------------------------------------ *
+ * global variables and defaults                                *
+ * ------------------------------------------------------------ */
+int verbose = 0;
+char progver[] = "1.2";              // fwsim program version, same as suncalc
+char dsetdir[256] = "./tracker-data";// dataset folder to simulate
+int cycle = 60;                      // tracker cycle in seconds
+int interval = 0;                    // dataset interval, 0 = from the day file size
+int cluster = 32768;                 // FAT cluster size of the SD card
+char axis[4] = "";                   // -a single-axis tracker angle, "" = both
+
+/* ------------------------------------------------------------ *
+ * dataset parameters from dset.txt, defaults for old datasets  *
+ * ------------------------------------------------------------ */
+struct dset {
+   char startdate[32];               // start-date: yyyymmdd
+   int dayfiles;                     // dayfiles-#
+   char daylayout[32];               // day-layout: fixed|adaptive|cheby|daylight|residual|columns
+   char srslayout[32];               // srs-layout: append|slots
+   char dirlayout[32];               // dir-layout: flat|yyyy/mm
+   int blockalign;                   // blockalign: 0 = packed records
+   int refyear;                      // resid-refy: reference year of residual files
+} dset = { "", 0, "fixed", "append", "flat", 0, 0 };
+
+/* ------------------------------------------------------------ *
+ * I/O counters, per day and for the whole dataset              *
+ * ------------------------------------------------------------ */
+struct iocost {
+   long sectors;                     // sector transfers
+   long split;                       // record reads across a sector boundary
+   long dirents;                     // folder entries scanned
+   long hops;                        // FAT cluster chain steps
+   long bytes;                       // record bytes read
+   long reads;                       // record read calls
+};
+
+/* ------------------------------------------------------------ *
+ * simfile is an open file as the MCU sees it: current cluster  *
+ * in the FAT chain. The SD library has one sector read cache,  *
+ * shared by all open files.                                    *
+ * ------------------------------------------------------------ */
+struct simfile {
+   int fd;                           // host file descriptor
+   long clus;                        // current cluster of the FAT chain
+};
+int cachefd = -1;                    // file of the cached sector, -1 = none
+long cachesec = -1;                  // sector number in the read cache
+
+/* ------------------------------------------------------------ *
+ * print_usage() prints the programs commandline instructions.  *
+ * ------------------------------------------------------------ */
+void usage() {
+   static char const usage[] = "Usage: ./fwsim [-d datafolder] [-c cycle] [-i interval] [-k clustersize] [-a az|ze] [-v]\n\
+\n\
+Command line parameters have the following format:\n\
+   -d   dataset folder created by suncalc, Example: -d ./tracker-data (default)\n\
+   -c   tracker cycle in seconds, one record read per cycle, Example: -c 60 (default)\n\
+   -i   dataset interval in seconds, default: taken from the fixed day file size\n\
+   -k   SD card FAT cluster size in bytes, Example: -k 32768 (default)\n\
+   -a   single-axis tracker, read only this angle of column day files (suncalc -l)\n\
+        and no day flags, Example: -a az\n\
+   -h   display this message\n\
+   -v   enable per day output\n\
+\n\
+Usage examples:\n\
+./suncalc -p ty -b -o ./tracker-data && ./fwsim -d ./tracker-data\n";
+   printf("fwsim v%s\n\n", progver);
+   printf(usage);
+}
+
+/* ------------------------------------------------------------ *
+ * read_dsetfile() reads the dataset keys fwsim needs to know   *
+ * ------------------------------------------------------------ */
+void read_dsetfile() {
+   FILE *fdset;
+   char fpath[1024], line[80], key[16], value[32];
+
+   snprintf(fpath, sizeof(fpath), "%s/dset.txt", dsetdir);
+   if(! (fdset=fopen(fpath, "r"))) {
+      printf("Error open %s for reading.\n", fpath);
+      exit(-1);
+   }
+   while(fgets(line, sizeof(line), fdset)) {
+      if(sscanf(line, "%15[^:]: %31s", key, value) != 2) continue;
+      if(strcmp(key, "start-date") == 0) snprintf(dset.startdate, sizeof(dset.startdate), "%s", value);
+      if(strcmp(key, "dayfiles-#") == 0) dset.dayfiles = atoi(value);
+      if(strcmp(key, "day-layout") == 0) snprintf(dset.daylayout, sizeof(dset.daylayout), "%s", value);
+      if(strcmp(key, "srs-layout") == 0) snprintf(dset.srslayout, sizeof(dset.srslayout), "%s", value);
+      if(strcmp(key, "dir-layout") == 0) snprintf(dset.dirlayout, sizeof(dset.dirlayout), "%s", value);
+      if(strcmp(key, "blockalign") == 0) dset.blockalign = atoi(value);
+      if(strcmp(key, "resid-refy") == 0) dset.refyear = atoi(value);
+   }
+   fclose(fdset);
+   if(strlen(dset.startdate) != 8 || dset.dayfiles < 1) {
+      printf("Error: %s has no valid start-date or dayfiles-#.\n", fpath);
+      exit(-1);
+   }
+}
+
+/* ------------------------------------------------------------ *
+ * fat_entries() returns the number of FAT folder entries of a  *
+ * file name: one for 8.3 names, plus long file name entries   *
+ * of 13 characters each for all other names.                   *
+ * ------------------------------------------------------------ */
+int fat_entries(const char *name) {
+   const char *dot = strrchr(name, '.');
+   size_t len = strlen(name);
+
+   if(dot && dot - name <= 8 && len - (dot - name) <= 4) return 1;
+   if(!dot && len <= 8) return 1;
+   return 1 + (int) ((len + 12) / 13);
+}
+
+/* ------------------------------------------------------------ *
+ * create_order() returns the position of a dataset file in the *
+ * order suncalc creates it: the srs files on the first day of  *
+ * a year, then the year folder, then the files of each day in  *
+ * the order write_dayfiles() writes them. dset.txt is written  *
+ * at the end of the run, other files are put there as well.    *
+ * ------------------------------------------------------------ */
+long create_order(const char *name) {
+   static const char *ext[] = { "az", "ze", "df", "csv", "bin", "idx", "chb", "rsd" };
+   const char *dot = strchr(name, '.');
+   size_t digits = strspn(name, "0123456789");
+   long date;
+   int i;
+
+   if(sscanf(name, "srs-%4ld", &date) == 1)
+      return date * 10000 * 16 + (dot && strcmp(dot, ".csv") == 0 ? 1 : 0);
+   if(digits == 0) return LONG_MAX;
+   date = atol(name);
+   if(digits == 4 && !dot) return date * 10000 * 16 + 2;
+   for(i = 0; dot && i < 8; i++)
+      if(strcmp(dot + 1, ext[i]) == 0) return date * 16 + 3 + i;
+   return date * 16 + 15;
+}
+
+/* ------------------------------------------------------------ *
+ * create_sort() orders folder entries by creation for qsort()  *
+ * ------------------------------------------------------------ */
+int create_sort(const void *a, const void *b) {
+   const char *na = *(char * const *) a, *nb = *(char * const *) b;
+   long oa = create_order(na), ob = create_order(nb);
+
+   if(oa != ob) return oa < ob ? -1 : 1;
+   return strcmp(na, nb);
+}
+
+/* ------------------------------------------------------------ *
+ * dir_scan() returns the number of folder entries the SD lib   *
+ * reads to find name in folder. FAT lists entries in creation  *
+ * order, see create_order(). Subfolders start with the . and   *
+ * .. entries.                                                  *
+ * ------------------------------------------------------------ */
+long dir_scan(const char *folder, const char *name, int subfolder) {
+   DIR *d;
+   struct dirent *p;
+   char **names = NULL;
+   int num = 0, i;
+   long scanned = subfolder ? 2 : 0;
+
+   if(! (d = opendir(folder))) {
+      printf("Error open folder %s\n", folder);
+      exit(-1);
+   }
+   while((p = readdir(d))) {
+      if(!strcmp(p->d_name, ".") || !strcmp(p->d_name, "..")) continue;
+      names = realloc(names, (num + 1) * sizeof(char *));
+      names[num++] = strdup(p->d_name);
+   }
+   closedir(d);
+   qsort(names, num, sizeof(char *), create_sort);
+   for(i = 0; i < num; i++) {
+      scanned += fat_entries(names[i]);
+      if(strcmp(names[i], name) == 0) break;
+   }
+   if(i == num) {
+      printf("Error: %s not found in folder %s\n", name, folder);
+      exit(-1);
+   }
+   for(i = 0; i < num; i++) free(names[i]);
+   free(names);
+   return scanned;
+}
+
+/* ------------------------------------------------------------ *
+ * sim_open() opens a dataset file by its path below dsetdir,   *
+ * scanning each folder of the path like the SD library does.  *
+ * ------------------------------------------------------------ */
+void sim_open(struct simfile *f, const char *relpath, struct iocost *c) {
+   char folder[1024], part[64];
+   const char *p = relpath, *slash;
+   int depth = 0;
+
+   snprintf(folder, sizeof(folder), "%s", dsetdir);
+   while((slash = strchr(p, '/'))) {
+      snprintf(part, sizeof(part), "%.*s", (int) (slash - p), p);
+      c->dirents += dir_scan(folder, part, depth++ > 0);
+      strncat(folder, "/", sizeof(folder) - strlen(folder) - 1);
+      strncat(folder, part, sizeof(folder) - strlen(folder) - 1);
+      p = slash + 1;
+   }
+   c->dirents += dir_scan(folder, p, depth > 0);
+   strncat(folder, "/", sizeof(folder) - strlen(folder) - 1);
+   strncat(folder, p, sizeof(folder) - strlen(folder) - 1);
+   if((f->fd = open(folder, O_RDONLY)) < 0) {
+      printf("Error open %s for reading\n", folder);
+      exit(-1);
+   }
+   f->clus = 0;
+   if(cachefd == f->fd) cachefd = -1;
+}
+
+/* ------------------------------------------------------------ *
+ * sim_read() seeks to off and reads len bytes. A forward seek  *
+ * follows the FAT chain from the current cluster, a backward  *
+ * seek starts over from the first cluster of the file.        *
+ * ------------------------------------------------------------ */
+void sim_read(struct simfile *f, long off, int len, void *buf, struct iocost *c) {
+   long first = off / SECTOR, last = (off + len - 1) / SECTOR, s;
+   long endclus = (off + len - 1) / cluster;
+
+   if(off / cluster >= f->clus) c->hops += endclus - f->clus;
+   else c->hops += endclus;
+   f->clus = endclus;
+   for(s = first; s <= last; s++) {
+      if(f->fd != cachefd || s != cachesec) c->sectors++;
+      cachefd = f->fd;
+      cachesec = s;
+   }
+   if(last > first) c->split++;
+   c->bytes += len;
+   c->reads++;
+   if(pread(f->fd, buf, len, off) != len) memset(buf, 0, len);
+}
+
+/* ------------------------------------------------------------ *
+ * add_cost() adds the day counters to the dataset counters     *
+ * ------------------------------------------------------------ */
+void add_cost(struct iocost *sum, const struct iocost *c) {
+   sum->sectors += c->sectors;
+   sum->split   += c->split;
+   sum->dirents += c->dirents;
+   sum->hops    += c->hops;
+   sum->bytes   += c->bytes;
+   sum->reads   += c->reads;
+}
+
+/* ------------------------------------------------------------ *
+ * day_path() returns the day file path below dsetdir          *
+ * ------------------------------------------------------------ */
+void day_path(char *relpath, size_t len, int year, int month, int mday, const char *ext) {
+   if(strcmp(dset.dirlayout, "yyyy/mm") == 0)
+      snprintf(relpath, len, "%04d/%02d/%02d.%s", year, month, mday, ext);
+   else snprintf(relpath, len, "%04d%02d%02d.%s", year, month, mday, ext);
+}
+
+/* ------------------------------------------------------------ *
+ * sim_residual() replays one day of a residual day file. Each  *
+ * cycle reads the record of the reference year day file, and  *
+ * the residual record.                                         *
+ * ------------------------------------------------------------ */
+void sim_residual(struct tm *day, struct iocost *c) {
+   struct simfile fref, fres;
+   struct reshead head;
+   char relpath[64];
+   uint8_t rec[DAYREC_SIZE], res[4];
+   int32_t n, azi, zen;
+   int mday = day->tm_mday;
+   long sec;
+
+   day_path(relpath, sizeof(relpath), day->tm_year + 1900, day->tm_mon + 1, day->tm_mday, "rsd");
+   sim_open(&fres, relpath, c);
+   sim_read(&fres, 0, sizeof(head), &head, c);
+   if(day->tm_mon == 1 && mday == 29 && sunread_yday(dset.refyear, 3, 1) == 59) mday = 28;
+   day_path(relpath, sizeof(relpath), dset.refyear, day->tm_mon + 1, mday, "bin");
+   sim_open(&fref, relpath, c);
+   for(sec = 0; head.rows > 0 && sec < 86400; sec += cycle) {
+      n = sec / (86400 / head.rows);
+      sim_read(&fref, sunread_record_offset(n, 0, dset.blockalign), DAYREC_SIZE, rec, c);
+      sim_read(&fres, sunread_residual_offset(&head, n), 2 * head.size, res, c);
+      sunread_residual(&head, n, rec, res, &azi, &zen);
+   }
+   close(fref.fd);
+   close(fres.fd);
+}
+
+/* ------------------------------------------------------------ *
+ * sim_columns() replays one day of column day files. Each      *
+ * cycle reads the record of its time from the .df day flag and *
+ * the .az and .ze angle files. With '-a az' or '-a ze' it only *
+ * reads that one angle file, the .df file is not opened.       *
+ * ------------------------------------------------------------ */
+void sim_columns(struct tm *day, struct iocost *c) {
+   struct simfile fcol[3];
+   const char *ext[3] = { "df", "az", "ze" };
+   int size[3] = { COLFLAG_SIZE, COLANGLE_SIZE, COLANGLE_SIZE };
+   char relpath[64];
+   uint8_t rec[COLANGLE_SIZE];
+   long sec;
+   int i;
+
+   for(i = 0; i < 3; i++) {
+      fcol[i].fd = -1;
+      if(strlen(axis) > 0 && strcmp(axis, ext[i]) != 0) continue;
+      day_path(relpath, sizeof(relpath), day->tm_year + 1900, day->tm_mon + 1, day->tm_mday, ext[i]);
+      sim_open(&fcol[i], relpath, c);
+   }
+   if(interval == 0) {
+      struct stat st;
+      i = strlen(axis) > 0 ? (strcmp(axis, "az") == 0 ? 1 : 2) : 0;
+      fstat(fcol[i].fd, &st);
+      interval = st.st_size > 0 ? 86400 / (st.st_size / size[i]) : 60;
+   }
+   for(sec = 0; sec < 86400; sec += cycle) {
+      for(i = 0; i < 3; i++)
+         if(fcol[i].fd >= 0) sim_read(&fcol[i], (sec / interval) * size[i], size[i], rec, c);
+   }
+   for(i = 0; i < 3; i++) if(fcol[i].fd >= 0) close(fcol[i].fd);
+}
+
+/* ------------------------------------------------------------ *
+ * sim_day() replays one day of tracking on the day file, and   *
+ * reads the srs record for the day. n is the day in dataset.   *
+ * ------------------------------------------------------------ */
+void sim_day(struct tm *day, int n, struct iocost *c) {
+   struct simfile fday, fidx, fsrs;
+   char relpath[64];
+   const char *ext = strcmp(dset.daylayout, "cheby") == 0 ? "chb" : "bin";
+   uint8_t rec[DAYREC_SIZE], next[DAYREC_SIZE];
+   uint16_t idx[25];
+   struct dayhead head;
+   struct chebday cheb;
+   int32_t off, azi, zen;
+   long sec;
+   int i = -1;
+
+   /* -------------------------------------------------------- *
+    * the srs record, once per day                             *
+    * -------------------------------------------------------- */
+   snprintf(relpath, sizeof(relpath), "srs-%04d.bin", day->tm_year + 1900);
+   sim_open(&fsrs, relpath, c);
+   if(strcmp(dset.srslayout, "slots") == 0)
+      off = sunread_srs_offset(day->tm_year + 1900, day->tm_mon + 1, day->tm_mday);
+   else if(day->tm_year + 1900 == atoi(dset.startdate) / 10000)
+      off = (int32_t) n * SRSREC_SIZE;                      // the start year's file begins at start-date
+   else off = (int32_t) day->tm_yday * SRSREC_SIZE;
+   sim_read(&fsrs, off, SRSREC_SIZE, rec, c);
+   close(fsrs.fd);
+
+   /* -------------------------------------------------------- *
+    * open the day file, read the per day header data          *
+    * -------------------------------------------------------- */
+   if(strcmp(dset.daylayout, "residual") == 0 && day->tm_year + 1900 != dset.refyear) {
+      sim_residual(day, c);
+      return;
+   }
+   if(strcmp(dset.daylayout, "columns") == 0) {
+      sim_columns(day, c);
+      return;
+   }
+   day_path(relpath, sizeof(relpath), day->tm_year + 1900, day->tm_mon + 1, day->tm_mday, ext);
+   sim_open(&fday, relpath, c);
+   if(strcmp(dset.daylayout, "cheby") == 0) {
+      sim_read(&fday, 0, sizeof(cheb), &cheb, c);
+      close(fday.fd);
+      for(sec = 0; sec < 86400; sec += cycle) sunread_cheb(&cheb, sec, &azi, &zen);
+      return;
+   }
+   if(strcmp(dset.daylayout, "daylight") == 0) sim_read(&fday, 0, sizeof(head), &head, c);
+   if(strcmp(dset.daylayout, "adaptive") == 0) {
+      relpath[strlen(relpath) - 3] = '\0';
+      strcat(relpath, "idx");
+      sim_open(&fidx, relpath, c);
+      sim_read(&fidx, 0, sizeof(idx), idx, c);
+      close(fidx.fd);
+   }
+   if(interval == 0 && (strcmp(dset.daylayout, "fixed") == 0 || strcmp(dset.daylayout, "residual") == 0)) {
+      struct stat st;
+      fstat(fday.fd, &st);
+      long recs = dset.blockalign ? (st.st_size / dset.blockalign) * (dset.blockalign / DAYREC_SIZE)
+                                  : st.st_size / DAYREC_SIZE;
+      interval = recs > 0 ? 86400 / recs : 60;
+      if(dset.blockalign) while(86400 % interval) interval++;   // tail padding holds no records
+   }
+
+   /* -------------------------------------------------------- *
+    * one record read per tracker cycle                        *
+    * -------------------------------------------------------- */
+   for(sec = 0; sec < 86400; sec += cycle) {
+      uint8_t hour = sec / 3600, minute = (sec % 3600) / 60;
+      if(strcmp(dset.daylayout, "daylight") == 0) {
+         off = sunread_daylight_offset(&head, hour, minute, dset.blockalign);
+         if(off >= 0) sim_read(&fday, off, DAYREC_SIZE, rec, c);
+      }
+      else if(strcmp(dset.daylayout, "adaptive") == 0) {
+         /* ------------------------------------------------------ *
+          * the hour index gives the start record, then the MCU    *
+          * keeps the current record and reads ahead to the next   *
+          * ------------------------------------------------------ */
+         if(i < 0 && idx[24] > 0) {
+            i = idx[hour] > 0 ? idx[hour] - 1 : 0;
+            sim_read(&fday, sunread_record_offset(i, 0, dset.blockalign), DAYREC_SIZE, rec, c);
+            if(i + 1 < idx[24]) sim_read(&fday, sunread_record_offset(i + 1, 0, dset.blockalign), DAYREC_SIZE, next, c);
+         }
+         while(i >= 0 && i + 1 < idx[24] && next[0] * 60 + next[1] <= hour * 60 + minute) {
+            memcpy(rec, next, DAYREC_SIZE);
+            i++;
+            if(i + 1 < idx[24]) sim_read(&fday, sunread_record_offset(i + 1, 0, dset.blockalign), DAYREC_SIZE, next, c);
+         }
+      }
+      else {
+         off = sunread_record_offset(sec / interval, 0, dset.blockalign);
+         sim_read(&fday, off, DAYREC_SIZE, rec, c);
+      }
+   }
+   close(fday.fd);
+}
+
+/* ----------------------------------------------------------- *
+ * parseargs() checks the commandline arguments with C getopt  *
+ * ----------------------------------------------------------- */
+void parseargs(int argc, char* argv[]) {
+   int arg;
+   opterr = 0;
+
+   while ((arg = (int) getopt (argc, argv, "d:c:i:k:a:hv")) != -1) {
+      switch (arg) {
+         // arg -v verbose, type: flag, optional
+         case 'v':
+            verbose = 1; break;
+
+         // arg -d dataset folder
+         case 'd':
+            snprintf(dsetdir, sizeof(dsetdir), "%s", optarg);
+            break;
+
+         // arg -c tracker cycle type: int
+         case 'c':
+            cycle = atoi(optarg);
+            if(cycle < 1 || cycle > 3600) {
+               printf("Error: Cannot get valid cycle.\n");
+               exit(-1);
+            }
+            break;
+
+         // arg -i dataset interval type: int
+         case 'i':
+            interval = atoi(optarg);
+            if(interval < 60 || interval > 3600 || 86400 % interval != 0) {
+               printf("Error: Cannot get valid interval.\n");
+               exit(-1);
+            }
+            break;
+
+         // arg -k cluster size type: int
+         case 'k':
+            cluster = atoi(optarg);
+            if(cluster < SECTOR || cluster % SECTOR != 0) {
+               printf("Error: Cannot get valid cluster size.\n");
+               exit(-1);
+            }
+            break;
+
+         // arg -a tracker axis type: az|ze
+         case 'a':
+            if(strcmp(optarg, "az") != 0 && strcmp(optarg, "ze") != 0) {
+               printf("Error: Cannot get valid axis %s.\n", optarg);
+               exit(-1);
+            }
+            snprintf(axis, sizeof(axis), "%s", optarg);
+            break;
+
+         // arg -h usage, type: flag, optional
+         case 'h':
+            usage(); exit(0);
+            break;
+
+         default:
+            usage();
+            exit(-1);
+      }
+   }
+}
+
+/* ------------------------------------------------------------ *
+ * main() function to execute the program                       *
+ * ------------------------------------------------------------ */
+int main(int argc, char *argv[]) {
+   struct iocost sum = { 0 }, c;
+   struct tm day = { 0 };
+   int n;
+
+   parseargs(argc, argv);
+   read_dsetfile();
+   printf("Simulate dataset [%s] start [%s] days [%d]\n", dsetdir, dset.startdate, dset.dayfiles);
+   printf("Layout day [%s] srs [%s] dir [%s] blockalign [%d], cycle [%ds] cluster [%d]\n",
+          dset.daylayout, dset.srslayout, dset.dirlayout, dset.blockalign, cycle, cluster);
+
+   sscanf(dset.startdate, "%4d%2d%2d", &day.tm_year, &day.tm_mon, &day.tm_mday);
+   day.tm_year -= 1900;
+   day.tm_mon -= 1;
+   day.tm_hour = 12;
+   mktime(&day);
+   for(n = 0; n < dset.dayfiles; n++) {
+      memset(&c, 0, sizeof(c));
+      sim_day(&day, n, &c);
+      if(verbose == 1) printf("%04d-%02d-%02d sectors [%ld] split [%ld] dir entries [%ld] cluster hops [%ld] bytes [%ld]\n",
+                              day.tm_year + 1900, day.tm_mon + 1, day.tm_mday,
+                              c.sectors, c.split, c.dirents, c.hops, c.bytes);
+      add_cost(&sum, &c);
+      day.tm_mday++;
+      mktime(&day);
+   }
+   printf("Per day: sector reads [%.1f] split records [%.1f] dir entries [%.1f] cluster hops [%.1f] bytes [%.0f] reads [%.0f]\n",
+          (double) sum.sectors / n, (double) sum.split / n, (double) sum.dirents / n,
+          (double) sum.hops / n, (double) sum.bytes / n, (double) sum.reads / n);
+   return 0;
+}
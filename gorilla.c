@@ -0,0 +1,293 @@
+/* ------------------------------------------------------------ *
+ * file:        gorilla.c                                       *
+ * purpose:     compressed day record archive, see gorilla.h    *
+ *                                                              *
+ * Record encoding, bits are written MSB first:                 *
+ * time   -> minute of the day, the first record has 11 bits,   *
+ *           then the delta-of-delta: '0' for no change, or     *
+ *           '10' + 7, '110' + 9, '1110' + 12, '1111' + 32 bits *
+ * dflag  -> 1 bit, set if the flag changed                     *
+ * angles -> XOR with the predicted value: '0' if zero, '10' + *
+ *           the meaningful bits in the window of the previous  *
+ *           XOR, '11' + 5 bits leading zeros + 6 bits length-1 *
+ *           + the meaningful bits                              *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>
+#include <string.h>
+#include "gorilla.h"
+#include "sunread.h"
+
+/* ------------------------------------------------------------ *
+ * bit stream writer and reader                                 *
+ * ------------------------------------------------------------ */
+struct bitstream {
+   uint8_t *wbuf;                    // writer buffer, zeroed
+   const uint8_t *rbuf;              // reader buffer
+   long bits;                        // reader buffer size in bits
+   long pos;                         // current bit position
+   int error;                        // set if the reader ran out of data
+};
+
+static void put_bits(struct bitstream *s, uint64_t value, int n) {
+   while(n > 0) {
+      int room = 8 - (s->pos & 7);
+      int take = n < room ? n : room;
+      uint8_t part = (value >> (n - take)) & ((1u << take) - 1);
+      s->wbuf[s->pos >> 3] |= part << (room - take);
+      s->pos += take;
+      n -= take;
+   }
+}
+
+static uint64_t get_bits(struct bitstream *s, int n) {
+   uint64_t value = 0;
+
+   if(s->pos + n > s->bits) {
+      s->error = 1;
+      return 0;
+   }
+   while(n > 0) {
+      int room = 8 - (s->pos & 7);
+      int take = n < room ? n : room;
+      uint8_t part = (s->rbuf[s->pos >> 3] >> (room - take)) & ((1u << take) - 1);
+      value = (value << take) | part;
+      s->pos += take;
+      n -= take;
+   }
+   return value;
+}
+
+/* ------------------------------------------------------------ *
+ * predict() extrapolates the next value from the last three    *
+ * values with a constant delta-of-delta. Only additions are    *
+ * used, so no compiler can fuse the operations differently on  *
+ * the encoding and the decoding machine.                       *
+ * ------------------------------------------------------------ */
+static double predict(const double *v, int i) {
+   double d1, d2;
+
+   if(i == 0) return 0.0;
+   if(i == 1) return v[0];
+   d1 = v[i-1] - v[i-2];
+   if(i == 2) return v[i-1] + d1;
+   d2 = v[i-2] - v[i-3];
+   return v[i-1] + d1 + (d1 - d2);
+}
+
+static uint64_t dbits(double d) {
+   uint64_t u;
+   memcpy(&u, &d, sizeof(u));
+   return u;
+}
+
+static double bitsd(uint64_t u) {
+   double d;
+   memcpy(&d, &u, sizeof(d));
+   return d;
+}
+
+/* ------------------------------------------------------------ *
+ * xor window of the previous XOR value, per angle              *
+ * ------------------------------------------------------------ */
+struct window {
+   int lead;                         // leading zero bits, -1 = no window yet
+   int len;                          // meaningful bits
+};
+
+static void put_xor(struct bitstream *s, struct window *w, uint64_t x) {
+   int lead, trail;
+
+   if(x == 0) {
+      put_bits(s, 0, 1);
+      return;
+   }
+   lead = __builtin_clzll(x);
+   trail = __builtin_ctzll(x);
+   if(lead > 31) lead = 31;
+   if(w->lead >= 0 && lead >= w->lead && trail >= 64 - w->lead - w->len) {
+      put_bits(s, 2, 2);
+      put_bits(s, x >> (64 - w->lead - w->len), w->len);
+      return;
+   }
+   w->lead = lead;
+   w->len = 64 - lead - trail;
+   put_bits(s, 3, 2);
+   put_bits(s, lead, 5);
+   put_bits(s, w->len - 1, 6);
+   put_bits(s, x >> trail, w->len);
+}
+
+static uint64_t get_xor(struct bitstream *s, struct window *w) {
+   if(get_bits(s, 1) == 0) return 0;
+   if(get_bits(s, 1) == 1) {
+      w->lead = get_bits(s, 5);
+      w->len = get_bits(s, 6) + 1;
+   }
+   if(w->lead < 0 || w->lead + w->len > 64) {
+      s->error = 1;
+      return 0;
+   }
+   return get_bits(s, w->len) << (64 - w->lead - w->len);
+}
+
+/* ------------------------------------------------------------ *
+ * time delta-of-delta buckets                                  *
+ * ------------------------------------------------------------ */
+static void put_dod(struct bitstream *s, int32_t dod) {
+   if(dod == 0) put_bits(s, 0, 1);
+   else if(dod >= -64 && dod < 64) { put_bits(s, 2, 2); put_bits(s, dod & 0x7f, 7); }
+   else if(dod >= -256 && dod < 256) { put_bits(s, 6, 3); put_bits(s, dod & 0x1ff, 9); }
+   else if(dod >= -2048 && dod < 2048) { put_bits(s, 14, 4); put_bits(s, dod & 0xfff, 12); }
+   else { put_bits(s, 15, 4); put_bits(s, (uint32_t) dod, 32); }
+}
+
+static int32_t sign_extend(uint64_t v, int n) {
+   return (int32_t) ((int64_t) (v << (64 - n)) >> (64 - n));
+}
+
+static int32_t get_dod(struct bitstream *s) {
+   int n;
+
+   if(get_bits(s, 1) == 0) return 0;
+   if(get_bits(s, 1) == 0) n = 7;
+   else if(get_bits(s, 1) == 0) n = 9;
+   else if(get_bits(s, 1) == 0) n = 12;
+   else return (int32_t) get_bits(s, 32);
+   return sign_extend(get_bits(s, n), n);
+}
+
+/* ------------------------------------------------------------ *
+ * gor_encode() compresses one day of records into out          *
+ * ------------------------------------------------------------ */
+long gor_encode(uint8_t *out, int rows, const uint8_t *hour, const uint8_t *minute,
+                const uint8_t *dflag, const double *azimuth, const double *zenith) {
+   struct bitstream s = { out, NULL, 0, 0, 0 };
+   struct window wa = { -1, 0 }, wz = { -1, 0 };
+   int32_t t, last = 0, delta = 0;
+   int i;
+
+   memset(out, 0, gor_maxbytes(rows));
+   for(i = 0; i < rows; i++) {
+      t = hour[i] * 60 + minute[i];
+      if(i == 0) {
+         put_bits(&s, t, 11);
+         put_bits(&s, dflag[i], 1);
+      }
+      else {
+         put_dod(&s, (t - last) - delta);
+         delta = t - last;
+         put_bits(&s, dflag[i] != dflag[i-1], 1);
+      }
+      last = t;
+      put_xor(&s, &wa, dbits(azimuth[i]) ^ dbits(predict(azimuth, i)));
+      put_xor(&s, &wz, dbits(zenith[i]) ^ dbits(predict(zenith, i)));
+   }
+   return (s.pos + 7) >> 3;
+}
+
+/* ------------------------------------------------------------ *
+ * gor_decode() decompresses rows records into 19-byte records  *
+ * ------------------------------------------------------------ */
+int gor_decode(const uint8_t *in, long len, int rows, uint8_t *rec) {
+   struct bitstream s = { NULL, in, len * 8, 0, 0 };
+   struct window wa = { -1, 0 }, wz = { -1, 0 };
+   double *azimuth, *zenith;
+   int32_t t = 0, delta = 0;
+   uint8_t dflag = 0;
+   int i;
+
+   if(rows <= 0) return 0;
+   azimuth = malloc(rows * sizeof(double));
+   zenith = malloc(rows * sizeof(double));
+   for(i = 0; i < rows && s.error == 0; i++) {
+      if(i == 0) {
+         t = get_bits(&s, 11);
+         dflag = get_bits(&s, 1);
+      }
+      else {
+         delta += get_dod(&s);
+         t += delta;
+         dflag ^= get_bits(&s, 1);
+      }
+      azimuth[i] = bitsd(get_xor(&s, &wa) ^ dbits(predict(azimuth, i)));
+      zenith[i] = bitsd(get_xor(&s, &wz) ^ dbits(predict(zenith, i)));
+
+      rec[0] = t / 60;
+      rec[1] = t % 60;
+      rec[2] = dflag;
+      memcpy(rec + 3, &azimuth[i], sizeof(double));
+      memcpy(rec + 11, &zenith[i], sizeof(double));
+      rec += DAYREC_SIZE;
+   }
+   free(azimuth);
+   free(zenith);
+   return s.error ? -1 : 0;
+}
+
+/* ------------------------------------------------------------ *
+ * gor_create() creates the archive file and writes its header  *
+ * ------------------------------------------------------------ */
+int gor_create(struct garchive *a, const char *fpath) {
+   struct gorhead head = { GOR_MAGIC, GOR_VERSION };
+
+   a->days = 0;
+   a->index = NULL;
+   if(! (a->file = fopen(fpath, "w"))) return -1;
+   if(fwrite(&head, sizeof(head), 1, a->file) != 1) return -1;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * gor_append() writes the block of one day, and notes it in    *
+ * the block index                                              *
+ * ------------------------------------------------------------ */
+int gor_append(struct garchive *a, uint32_t date, uint32_t rows, const uint8_t *data, uint32_t bytes) {
+   struct gorblock block = { date, rows, bytes };
+   struct gorindex *index;
+
+   if(! (index = realloc(a->index, (a->days + 1) * sizeof(struct gorindex)))) return -1;
+   a->index = index;
+   a->index[a->days].date = date;
+   a->index[a->days].rows = rows;
+   a->index[a->days].offset = ftell(a->file);
+   a->days++;
+   if(fwrite(&block, sizeof(block), 1, a->file) != 1) return -1;
+   if(bytes > 0 && fwrite(data, bytes, 1, a->file) != 1) return -1;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * gor_close() writes the block index and the file tail         *
+ * ------------------------------------------------------------ */
+int gor_close(struct garchive *a) {
+   struct gortail tail = { GOR_MAGIC, a->days, 0 };
+   int result = 0;
+
+   tail.offset = ftell(a->file);
+   if(a->days > 0 && fwrite(a->index, sizeof(struct gorindex), a->days, a->file) != a->days) result = -1;
+   if(fwrite(&tail, sizeof(tail), 1, a->file) != 1) result = -1;
+   if(fclose(a->file) != 0) result = -1;
+   free(a->index);
+   a->index = NULL;
+   return result;
+}
+
+/* ------------------------------------------------------------ *
+ * gor_read_index() reads the block index of an archive file    *
+ * ------------------------------------------------------------ */
+int gor_read_index(FILE *f, struct gorindex **index) {
+   struct gorhead head;
+   struct gortail tail;
+
+   if(fseek(f, 0, SEEK_SET) != 0 || fread(&head, sizeof(head), 1, f) != 1) return -1;
+   if(head.magic != GOR_MAGIC || head.version != GOR_VERSION) return -1;
+   if(fseek(f, -(long) sizeof(tail), SEEK_END) != 0 || fread(&tail, sizeof(tail), 1, f) != 1) return -1;
+   if(tail.magic != GOR_MAGIC) return -1;
+   if(! (*index = malloc((tail.days + 1) * sizeof(struct gorindex)))) return -1;
+   if(fseek(f, tail.offset, SEEK_SET) != 0 ||
+      (tail.days > 0 && fread(*index, sizeof(struct gorindex), tail.days, f) != tail.days)) {
+      free(*index);
+      return -1;
+   }
+   return tail.days;
+}
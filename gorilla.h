@@ -0,0 +1,106 @@
+/* ------------------------------------------------------------ *
+ * file:        gorilla.h                                       *
+ * purpose:     compressed day record archive for long term     *
+ *              storage of suncalc data, written by suncalc -g  *
+ *              and read by sunarc.                             *
+ *                                                              *
+ * The archive holds one block per day, with the full interval *
+ * rows of the day. Time and dflag compress to a few bits per   *
+ * record, azimuth and zenith are XORed with the value predicted *
+ * from the last three values (constant delta-of-delta), and    *
+ * the XOR is stored Gorilla style with its leading and trailing *
+ * zero bits cut off. Decoding returns the exact 19-byte day    *
+ * file records.                                                *
+ * ------------------------------------------------------------ */
+#ifndef GORILLA_H
+#define GORILLA_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* ------------------------------------------------------------ *
+ * archive file layout:                                         *
+ * gorhead   -> file header                                     *
+ * gorblock  -> per day: block header, followed by bytes of the *
+ *              compressed records                              *
+ * gorindex  -> one entry per day block, after the last block   *
+ * gortail   -> points to the block index, at the end of file   *
+ * ------------------------------------------------------------ */
+#define GOR_MAGIC   0x31524f47       // "GOR1" little endian
+#define GOR_VERSION 1
+
+struct gorhead {
+   uint32_t magic;                   // GOR_MAGIC
+   uint32_t version;                 // GOR_VERSION
+};
+
+struct gorblock {
+   uint32_t date;                    // day as yyyymmdd
+   uint32_t rows;                    // number of records
+   uint32_t bytes;                   // compressed size of the records
+};
+
+struct gorindex {
+   uint32_t date;                    // day as yyyymmdd
+   uint32_t rows;                    // number of records
+   uint64_t offset;                  // file offset of the gorblock
+};
+
+struct gortail {
+   uint32_t magic;                   // GOR_MAGIC
+   uint32_t days;                    // number of index entries
+   uint64_t offset;                  // file offset of the block index
+};
+
+/* ------------------------------------------------------------ *
+ * the most records in one day block: 1440 at 60s intervals,   *
+ * plus the extra hour on the end of daylight saving time       *
+ * ------------------------------------------------------------ */
+#define GOR_MAXROWS 1500
+
+/* ------------------------------------------------------------ *
+ * gor_maxbytes() returns the buffer size needed to compress    *
+ * rows records, for the worst case of no compression at all.   *
+ * ------------------------------------------------------------ */
+#define gor_maxbytes(rows) ((rows) * 24 + 32)
+
+/* ------------------------------------------------------------ *
+ * gor_encode() compresses one day of records into out, returns *
+ * the number of bytes used.                                    *
+ * ------------------------------------------------------------ */
+long gor_encode(uint8_t *out, int rows, const uint8_t *hour, const uint8_t *minute,
+                const uint8_t *dflag, const double *azimuth, const double *zenith);
+
+/* ------------------------------------------------------------ *
+ * gor_decode() decompresses rows records from in (len bytes)   *
+ * into rec as 19-byte day file records, returns 0, or -1 if the *
+ * data is truncated.                                           *
+ * ------------------------------------------------------------ */
+int gor_decode(const uint8_t *in, long len, int rows, uint8_t *rec);
+
+/* ------------------------------------------------------------ *
+ * garchive holds an archive file that is being written         *
+ * ------------------------------------------------------------ */
+struct garchive {
+   FILE *file;
+   uint32_t days;                    // blocks written so far
+   struct gorindex *index;           // block index, written by gor_close()
+};
+
+/* ------------------------------------------------------------ *
+ * gor_create() creates the archive file, gor_append() adds the *
+ * compressed block of one day, and gor_close() writes the      *
+ * block index. All three return 0, or -1 on write errors.      *
+ * ------------------------------------------------------------ */
+int gor_create(struct garchive *a, const char *fpath);
+int gor_append(struct garchive *a, uint32_t date, uint32_t rows, const uint8_t *data, uint32_t bytes);
+int gor_close(struct garchive *a);
+
+/* ------------------------------------------------------------ *
+ * gor_read_index() checks the archive file and reads its block *
+ * index into a malloc'ed array. Returns the number of days, or *
+ * -1 if the file is no valid archive.                          *
+ * ------------------------------------------------------------ */
+int gor_read_index(FILE *f, struct gorindex **index);
+
+#endif
@@ -0,0 +1,584 @@
+/* ------------------------------------------------------------ *
+ * file:        libsuncalc.c                                    *
+ * purpose:     sun position dataset generator, see libsuncalc.h *
+ *                                                              *
+ * requires:	solar positioning algorithm (SPA) headers       *
+ *              and source files http://midcdmz.nrel.gov/spa    *
+ * ------------------------------------------------------------ */
+#include <stdio.h>     // debug output
+#include <string.h>    // period codes
+#include <math.h>      // round()
+#include "libsuncalc.h"
+
+/* ------------------------------------------------------------ *
+ * fixed SPA input values: elevation, pressure, temperature,    *
+ * slope, atmospheric refraction, delta_t                       *
+ * ------------------------------------------------------------ */
+#define DELTA_UT1	0
+#define DELTA_T		67
+#define ELEVATION	1000
+#define PRESSURE	1000
+#define TEMPERATURE	19
+#define SLOPE		0
+#define AZM_ROTATION	0
+#define ATM_REFRACT	0.5667
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+/* ------------------------------------------------------------ *
+ * sun_engine() returns the SPA input values above as text      *
+ * ------------------------------------------------------------ */
+const char *sun_engine(void) {
+   return "spa delta_ut1=" STR(DELTA_UT1) " delta_t=" STR(DELTA_T) " elevation=" STR(ELEVATION)
+          " pressure=" STR(PRESSURE) " temperature=" STR(TEMPERATURE) " slope=" STR(SLOPE)
+          " azm_rotation=" STR(AZM_ROTATION) " atmos_refract=" STR(ATM_REFRACT);
+}
+
+/* ------------------------------------------------------------ *
+ * sun_period() sets the start and end time for a period code   *
+ * ------------------------------------------------------------ */
+int sun_period(const char *period, time_t now, time_t *start, time_t *end) {
+   struct tm start_tm, end_tm;
+
+   /* ----------------------------------------------------------- *
+    * always run over a full day: start 00:00:00 end 00:00:00 +1d *
+    * ----------------------------------------------------------- */
+   localtime_r(&now, &start_tm);
+   start_tm.tm_hour = 0;
+   start_tm.tm_min  = 0;
+   start_tm.tm_sec  = 0;
+   end_tm = start_tm;
+
+   if(strcmp(period, "nd") == 0) {      // tomorrow
+      start_tm.tm_mday += 1;
+      end_tm.tm_mday += 2;
+   }
+   else if(strcmp(period, "nm") == 0) { // next month
+      start_tm.tm_mon += 1;             // count 1 month forward
+      start_tm.tm_mday = 1;             // set start day to 1st
+      end_tm.tm_mon += 2;               // count 2 months forward
+      end_tm.tm_mday = 1;               // set end day to 1st
+   }
+   else if(strcmp(period, "nq") == 0) { // next quarter
+   }
+   else if(strcmp(period, "ny") == 0) { // next year
+      start_tm.tm_year += 1;            // count year forward
+      start_tm.tm_mon   = 0;            // set month to Jan
+      start_tm.tm_mday  = 1;            // set day to 1st
+      end_tm.tm_year += 2;              // count 2 years forward
+      end_tm.tm_mon   = 0;              // set month to Jan
+      end_tm.tm_mday  = 1;              // set day to 1st
+   }
+   else if(strcmp(period, "td") == 0) { // this month
+      end_tm.tm_mday += 1;
+   }
+   else if(strcmp(period, "tm") == 0) { // this month
+      start_tm.tm_mday = 1;             // set start day to 1st
+      end_tm.tm_mon += 1;               // count 1 month forward
+      end_tm.tm_mday = 1;               // set end day to 1st
+   }
+   else if(strcmp(period, "tq") == 0) { // this quarter
+   }
+   else if(strcmp(period, "ty") == 0) { // this year
+      start_tm.tm_mon   = 0;            // set month to Jan
+      start_tm.tm_mday  = 1;            // set start day to 1st
+      end_tm.tm_year += 1;              // count 1 year forward
+      end_tm.tm_mon   = 0;              // set month to Jan
+      end_tm.tm_mday  = 1;              // set day to 1st
+   }
+   else if(strcmp(period, "2y") == 0) { // this year + next year
+      start_tm.tm_mon   = 0;            // set month to Jan
+      start_tm.tm_mday  = 1;            // set start day to 1st
+      end_tm.tm_year += 2;              // count 2 years forward
+      end_tm.tm_mon   = 0;              // set month to Jan
+      end_tm.tm_mday  = 1;              // set day to 1st
+   }
+   else if(strcmp(period, "tf") == 0) { // this year + next year
+      start_tm.tm_mon   = 0;            // set month to Jan
+      start_tm.tm_mday  = 1;            // set start day to 1st
+      end_tm.tm_year += 10;             // count 10 years forward
+      end_tm.tm_mon   = 0;              // set month to Jan
+      end_tm.tm_mday  = 1;              // set day to 1st
+   }
+   else return -1;
+
+   *start = mktime(&start_tm);
+   *end = mktime(&end_tm);
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * spa_errors() passes an SPA input error to the sinks          *
+ * ------------------------------------------------------------ */
+static void spa_errors(struct sungen *g, const spa_data *spa, int errcode) {
+   int s;
+
+   for(s = 0; s < g->nsinks; s++)
+      if(g->sinks[s].spaerror) g->sinks[s].spaerror(g->sinks[s].ctx, spa, errcode);
+}
+
+/* ----------------------------------------------------------- *
+ * srsazimut() calculates the azimuth values at sunrise sunset *
+ * ----------------------------------------------------------- */
+static uint16_t srsazimuth(struct sungen *g, spa_data spa, struct tm srs_tm) {
+   int result = 0;
+   uint16_t azimuth = 0;
+   /* -------------------------------------------------------- *
+    * copy the original spa structure to local copy called srs *
+    * -------------------------------------------------------- */
+   spa_data srs = spa;
+   /* -------------------------------------------------------- *
+    * set the sunrise/sunset time for spa calculation          *
+    * -------------------------------------------------------- */
+   srs.hour   = srs_tm.tm_hour;
+   srs.minute = srs_tm.tm_min;
+   srs.second = srs_tm.tm_sec;
+  /* -------------------------------------------------------- *
+   * call the calculation function and pass the SPA structure *
+   * -------------------------------------------------------- */
+   result = spa_calculate(&srs);
+   if(result > 0) spa_errors(g, &srs, result);
+  /* -------------------------------------------------------- *
+   * round the double value of azimuth to full degrees        *
+   * -------------------------------------------------------- */
+   azimuth = (uint16_t) round(srs.azimuth);
+   return azimuth;
+}
+
+/* ----------------------------------------------------------- *
+ * transelevation() calculates the day's max elevation angle   *
+ * ----------------------------------------------------------- */
+static int16_t transelevation(struct sungen *g, spa_data spa, struct tm transit_tm) {
+   int result = 0;
+   int16_t zenith = 0;
+   int16_t elevation = 0;
+   /* -------------------------------------------------------- *
+    * copy the original spa structure to local copy transit    *
+    * -------------------------------------------------------- */
+   spa_data transit = spa;
+
+   /* -------------------------------------------------------- *
+    * set the sunrise/sunset time for spa calculation          *
+    * -------------------------------------------------------- */
+   transit.hour   = transit_tm.tm_hour;
+   transit.minute = transit_tm.tm_min;
+   transit.second = transit_tm.tm_sec;
+  /* -------------------------------------------------------- *
+   * call the calculation function and pass the SPA structure *
+   * -------------------------------------------------------- */
+   result = spa_calculate(&transit);
+   if(result > 0) spa_errors(g, &transit, result);
+  /* -------------------------------------------------------- *
+   * round the double value of azimuth to full degrees        *
+   * -------------------------------------------------------- */
+   zenith = (int16_t) round(transit.zenith);
+  /* -------------------------------------------------------- *
+   * Because the spa algorithm returns the zenith distance we *
+   * convert it into elevation. elevation + z-distance = 90   *
+   * For nighttime, the elevation becomes negative, but here  *
+   * we only use it for transit time peak value (solar noon). *
+   * -------------------------------------------------------- */
+   elevation = 90 - zenith;
+   return elevation;
+}
+
+/* ------------------------------------------------------------ *
+ * srs_record() creates the sunrise/sunset record for one day  *
+ * ------------------------------------------------------------ */
+static struct drecord srs_record(struct sungen *g, spa_data spa, struct tm calc_tm, struct tm rise_tm,
+                                 struct tm transit_tm, struct tm set_tm) {
+   /* -------------------------------------------------------- *
+    * Get sunrise and sunset azimuth values for the new day    *
+    * -------------------------------------------------------- */
+   uint16_t razi = 0;
+   uint16_t sazi = 0;
+   razi = srsazimuth(g, spa, rise_tm);
+   sazi = srsazimuth(g, spa, set_tm);
+   if(g->conf.verbose == 1) printf("Debug: sunrise/sunset [%d - %d] azimuth range [%d] \n", razi, sazi, sazi-razi);
+
+   /* -------------------------------------------------------- *
+    * Get zenith max elevation angle at sun transit (noon)time *
+    * -------------------------------------------------------- */
+   int16_t tele = 0;
+   tele = transelevation(g, spa, transit_tm);
+   if(g->conf.verbose == 1) printf("Debug: suntransit at [%d:%d] elevation [%d] \n",
+                                   transit_tm.tm_hour, transit_tm.tm_min, tele);
+
+   /* -------------------------------------------------------- *
+    * create sunrise/sunset file binary data output structure  *
+    * -------------------------------------------------------- */
+   struct drecord srs;
+   srs.month            = calc_tm.tm_mon+1;
+   srs.day              = calc_tm.tm_mday;
+   srs.risehour         = rise_tm.tm_hour;
+   srs.riseminute       = rise_tm.tm_min;
+   srs.riseazimuth      = razi;
+   srs.transithour      = transit_tm.tm_hour;
+   srs.transitminute    = transit_tm.tm_min;
+   srs.transitelevation = tele;
+   srs.sethour          = set_tm.tm_hour;
+   srs.setminute        = set_tm.tm_min;
+   srs.setazimuth       = sazi;
+   return srs;
+}
+
+/* ------------------------------------------------------------ *
+ * srs_time() converts an SPA fractional hour into the time of  *
+ * the day calc_tm                                              *
+ * ------------------------------------------------------------ */
+static struct tm srs_time(struct tm calc_tm, double hours) {
+   float min, sec;
+   struct tm t = calc_tm;
+
+   min = 60.0*(hours - (int)(hours));
+   sec = 60.0*(min - (int)min);
+   t.tm_hour = (int)(hours);
+   t.tm_min = (int)min;
+   t.tm_sec = (int)sec;
+   return t;
+}
+
+/* ------------------------------------------------------------ *
+ * spa_setup() sets the SPA input for the site of conf, at the  *
+ * date and time of tm                                          *
+ * ------------------------------------------------------------ */
+static void spa_setup(spa_data *spa, const struct sunconf *conf, const struct tm *tm) {
+   memset(spa, 0, sizeof(*spa));
+   spa->year          = (int) tm->tm_year+1900;
+   spa->month         = tm->tm_mon+1;
+   spa->day           = tm->tm_mday;
+   spa->hour          = tm->tm_hour;
+   spa->minute        = tm->tm_min;
+   spa->second        = tm->tm_sec;
+   spa->timezone      = conf->timezone;  // - for trailing GMT, e.g. US, + for ahead of GMT, e.g. Japan
+   spa->delta_ut1     = DELTA_UT1;
+   spa->delta_t       = DELTA_T;
+   spa->longitude     = conf->longitude;
+   spa->latitude      = conf->latitude;
+   spa->elevation     = ELEVATION;
+   spa->pressure      = PRESSURE;
+   spa->temperature   = TEMPERATURE;
+   spa->slope         = SLOPE;
+   spa->azm_rotation  = AZM_ROTATION;
+   spa->atmos_refract = ATM_REFRACT;
+   spa->function      = SPA_ALL;
+}
+
+/* ------------------------------------------------------------ *
+ * sun_position() calculates the position at time t, the day    *
+ * flag uses the sunrise and sunset of the same SPA call, the   *
+ * same way as sungen_run()                                     *
+ * ------------------------------------------------------------ */
+int sun_position(const struct sunconf *conf, time_t t, struct sunpos *p) {
+   struct tm calc_tm, rise_tm, set_tm;
+   spa_data spa;
+   int result;
+
+   localtime_r(&t, &calc_tm);
+   spa_setup(&spa, conf, &calc_tm);
+   if((result = spa_calculate(&spa)) > 0) return result;
+   rise_tm = srs_time(calc_tm, spa.sunrise);
+   set_tm = srs_time(calc_tm, spa.sunset);
+   p->azimuth = spa.azimuth;
+   p->zenith = spa.zenith;
+   p->elevation = 90 - spa.zenith;
+   p->dflag = t >= mktime(&rise_tm) && t <= mktime(&set_tm);
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * series_newday() takes the SPA result at 00:00 as the day of  *
+ * the series, for the day flag of its samples                  *
+ * ------------------------------------------------------------ */
+static void series_newday(struct sunseries *s, const spa_data *spa, struct tm calc_tm) {
+   struct tm rise_tm = srs_time(calc_tm, spa->sunrise);
+   struct tm set_tm = srs_time(calc_tm, spa->sunset);
+
+   s->dayspa = *spa;
+   s->trise = mktime(&rise_tm);
+   s->tset = mktime(&set_tm);
+}
+
+/* ------------------------------------------------------------ *
+ * series_fill() calculates the next batch of samples. It stops *
+ * before 00:00 of the next day, so sunseries_day() is valid    *
+ * for the whole batch, and right after 00:00, so the day can  *
+ * be skipped. A series that does not start at 00:00 gets its  *
+ * day from one extra SPA call for 00:00.                       *
+ * ------------------------------------------------------------ */
+static void series_fill(struct sunseries *s) {
+   struct sunsample *x;
+   struct tm calc_tm;
+   spa_data spa = s->spa;
+   int result;
+
+   s->pos = 0;
+   s->count = 0;
+   while(s->count < SUNBATCH && s->next < s->conf.end) {
+      localtime_r(&s->next, &calc_tm);
+      if(calc_tm.tm_hour == 0 && calc_tm.tm_min == 0 && s->count > 0) break;
+      spa.year   = (int) calc_tm.tm_year+1900;
+      spa.month  = calc_tm.tm_mon+1;
+      spa.day    = calc_tm.tm_mday;
+      spa.hour   = calc_tm.tm_hour;
+      spa.minute = calc_tm.tm_min;
+      spa.second = calc_tm.tm_sec;
+      result = spa_calculate(&spa);
+      if(result > 0 && s->spaerror) s->spaerror(s->ctx, &spa, result);
+      if(calc_tm.tm_hour == 0 && calc_tm.tm_min == 0) series_newday(s, &spa, calc_tm);
+      else if(s->next == s->conf.start) {
+         spa_data day = spa;
+         day.hour = day.minute = day.second = 0;
+         spa_calculate(&day);
+         series_newday(s, &day, calc_tm);
+      }
+      /* -------------------------------------------------------- *
+       * Create dayflag, needs to occur after sunrise/sunset calc *
+       * -------------------------------------------------------- */
+      x = &s->batch[s->count++];
+      x->time    = s->next;
+      x->azimuth = spa.azimuth;
+      x->zenith  = spa.zenith;
+      x->dflag   = s->next >= s->trise && s->next <= s->tset;
+      x->hour    = calc_tm.tm_hour;
+      x->minute  = calc_tm.tm_min;
+      x->second  = calc_tm.tm_sec;
+      s->next += s->conf.interval;
+      if(calc_tm.tm_hour == 0 && calc_tm.tm_min == 0) break;
+   }
+   s->spa = spa;
+}
+
+/* ------------------------------------------------------------ *
+ * sunseries_init() prepares a series, the SPA input is set up  *
+ * once, the batches only change the date and time              *
+ * ------------------------------------------------------------ */
+int sunseries_init(struct sunseries *s, const struct sunconf *conf) {
+   struct tm start_tm;
+
+   if(conf->interval < 60 || conf->interval > 3600 || 86400 % conf->interval != 0) return -1;
+   s->conf = *conf;
+   s->next = conf->start;
+   s->trise = s->tset = 0;
+   s->pos = s->count = 0;
+   s->ctx = NULL;
+   s->spaerror = NULL;
+   localtime_r(&conf->start, &start_tm);
+   spa_setup(&s->spa, conf, &start_tm);
+   s->dayspa = s->spa;
+   return 0;
+}
+
+int sunseries_next(struct sunseries *s, struct sunsample *x) {
+   if(s->pos == s->count) series_fill(s);
+   if(s->count == 0) return 0;
+   *x = s->batch[s->pos++];
+   return 1;
+}
+
+const spa_data *sunseries_day(const struct sunseries *s) {
+   return &s->dayspa;
+}
+
+/* ------------------------------------------------------------ *
+ * sunseries_skipday() moves next to 00:00 of the following day *
+ * by mktime(), a DST switch day has 23 or 25 hours            *
+ * ------------------------------------------------------------ */
+void sunseries_skipday(struct sunseries *s) {
+   struct tm next_tm;
+   time_t last = s->next - s->conf.interval;
+
+   if(s->pos > 0) last = s->batch[s->pos - 1].time;
+   localtime_r(&last, &next_tm);
+   next_tm.tm_mday += 1;
+   next_tm.tm_hour = next_tm.tm_min = next_tm.tm_sec = 0;
+   next_tm.tm_isdst = -1;
+   s->next = mktime(&next_tm);
+   if(s->next > s->conf.end) s->next = s->conf.end;
+   s->pos = s->count = 0;
+}
+
+/* ------------------------------------------------------------ *
+ * sun_dayposition() finds the record before t by index, the    *
+ * generator steps the records by interval in unix time, also   *
+ * on DST switch days. The azimuth interpolation goes the short *
+ * way around north.                                            *
+ * ------------------------------------------------------------ */
+int sun_dayposition(const struct dayset *d, time_t t, double *azimuth, double *zenith) {
+   int r = 0;
+   double f, delta;
+
+   if(d->rows > 1 && t > d->time[0]) {
+      r = (t - d->time[0]) / (d->time[1] - d->time[0]);
+      if(r > d->rows - 1) r = d->rows - 1;
+   }
+   *azimuth = d->azimuth[r];
+   *zenith = d->zenith[r];
+   if(r + 1 < d->rows && t > d->time[r]) {
+      f = (double) (t - d->time[r]) / (d->time[r + 1] - d->time[r]);
+      delta = d->azimuth[r + 1] - d->azimuth[r];
+      if(delta > 180) delta -= 360;
+      if(delta < -180) delta += 360;
+      *azimuth += f * delta;
+      if(*azimuth < 0) *azimuth += 360;
+      if(*azimuth >= 360) *azimuth -= 360;
+      *zenith += f * (d->zenith[r + 1] - d->zenith[r]);
+   }
+   return d->dflag[r];
+}
+
+/* ------------------------------------------------------------ *
+ * sungen_init() prepares a generator for conf                  *
+ * ------------------------------------------------------------ */
+int sungen_init(struct sungen *g, const struct sunconf *conf) {
+   struct tm start_tm;
+
+   if(conf->interval < 60 || conf->interval > 3600 || 86400 % conf->interval != 0) return -1;
+   g->conf = *conf;
+   g->nsinks = 0;
+   g->day.rows = 0;
+   g->days = difftime(conf->end, conf->start) / 86400;
+   if(g->days < 0) g->days = 0;
+
+   localtime_r(&conf->start, &start_tm);
+   spa_setup(&g->spastart, conf, &start_tm);
+   g->spastart.hour   = 0;
+   g->spastart.minute = 0;
+   g->spastart.second = 0;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * sungen_sink() adds a result sink to the generator            *
+ * ------------------------------------------------------------ */
+int sungen_sink(struct sungen *g, const struct sunsink *sink) {
+   if(g->nsinks >= SUNSINKS) return -1;
+   g->sinks[g->nsinks++] = *sink;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * want_day() returns 0 if no sink needs the positions of the   *
+ * day, see struct sunsink                                      *
+ * ------------------------------------------------------------ */
+static int want_day(struct sungen *g, const struct tm *calc_tm) {
+   int s, days = 0;
+
+   for(s = 0; s < g->nsinks; s++) {
+      if(!g->sinks[s].day) continue;
+      if(!g->sinks[s].want || g->sinks[s].want(g->sinks[s].ctx, calc_tm->tm_year + 1900,
+                                               calc_tm->tm_mon + 1, calc_tm->tm_mday)) return 1;
+      days++;
+   }
+   return days == 0;
+}
+
+/* ------------------------------------------------------------ *
+ * send_day() passes the buffered day to the sinks              *
+ * ------------------------------------------------------------ */
+static int send_day(struct sungen *g) {
+   int s, result;
+
+   for(s = 0; s < g->nsinks; s++)
+      if(g->sinks[s].day && (result = g->sinks[s].day(g->sinks[s].ctx, &g->day)) != 0) return result;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * series_error() passes the SPA errors of the series to sinks  *
+ * ------------------------------------------------------------ */
+static void series_error(void *ctx, const spa_data *spa, int errcode) {
+   spa_errors((struct sungen *) ctx, spa, errcode);
+}
+
+/* ------------------------------------------------------------ *
+ * sungen_run() cycles through the calculation period           *
+ * ------------------------------------------------------------ */
+int sungen_run(struct sungen *g) {
+   struct dayset *d = &g->day;
+   struct sunseries series;
+   struct sunsample x;
+   struct tm calc_tm, rise_tm, transit_tm, set_tm;
+   const spa_data *spa;
+   time_t tday;
+   int result, s;
+
+   if(g->conf.verbose == 1) printf("Debug: data days/rows [%d/%d]\n", g->days, 86400 / g->conf.interval);
+   if(sunseries_init(&series, &g->conf) != 0) return -1;
+   series.ctx = g;
+   series.spaerror = series_error;
+   d->rows = 0;
+   while(sunseries_next(&series, &x)) {
+      /* -------------------------------------------------------- *
+       * check if we got a new day to process                     *
+       * -------------------------------------------------------- */
+      if(x.hour == 0 && x.minute == 0) {
+         /* -------------------------------------------------------- *
+          * pass on the previous day                                 *
+          * -------------------------------------------------------- */
+         if(d->rows > 0 && (result = send_day(g)) != 0) return result;
+         /* -------------------------------------------------------- *
+          * assign the days sunrise, suntransit and sunset time      *
+          * -------------------------------------------------------- */
+         spa = sunseries_day(&series);
+         tday = x.time;
+         localtime_r(&tday, &calc_tm);
+         rise_tm = srs_time(calc_tm, spa->sunrise);
+         transit_tm = srs_time(calc_tm, spa->suntransit);
+         set_tm = srs_time(calc_tm, spa->sunset);
+         if(g->conf.verbose == 1) printf("Debug: sunrise sunset [%02d:%02d:%02d] [%02d:%02d:%02d]\n",
+                                         rise_tm.tm_hour, rise_tm.tm_min, rise_tm.tm_sec,
+                                         set_tm.tm_hour, set_tm.tm_min, set_tm.tm_sec);
+
+         /* -------------------------------------------------------- *
+          * create the sunrise/sunset record for the sinks           *
+          * -------------------------------------------------------- */
+         struct drecord srs = srs_record(g, *spa, calc_tm, rise_tm, transit_tm, set_tm);
+         for(s = 0; s < g->nsinks; s++)
+            if(g->sinks[s].srs &&
+               (result = g->sinks[s].srs(g->sinks[s].ctx, &srs, calc_tm.tm_year + 1900, calc_tm.tm_yday)) != 0)
+               return result;
+
+         /* -------------------------------------------------------- *
+          * go on with the next day if the sinks have this one       *
+          * -------------------------------------------------------- */
+         d->rows = 0;
+         if(!want_day(g, &calc_tm)) {
+            if(g->conf.verbose == 1) printf("Debug: skip day [%04d-%02d-%02d]\n",
+                                            calc_tm.tm_year + 1900, calc_tm.tm_mon + 1, calc_tm.tm_mday);
+            sunseries_skipday(&series);
+            continue;
+         }
+
+         /* -------------------------------------------------------- *
+          * start buffering the new day                              *
+          * -------------------------------------------------------- */
+         d->year  = calc_tm.tm_year + 1900;
+         d->month = calc_tm.tm_mon + 1;
+         d->day   = calc_tm.tm_mday;
+         d->rows  = 0;
+         d->spa   = *spa;
+      }
+      if(g->conf.verbose == 1) printf("Debug: calc data set [%04d-%02d-%02d %02d:%02d:%02d] Z[%07.3f] A[%07.3f] DF[%d]\n",
+                                      d->year, d->month, d->day, x.hour, x.minute, x.second,
+                                      x.zenith, x.azimuth, x.dflag);
+      /* -------------------------------------------------------- *
+       * add the result to the day buffer                         *
+       * -------------------------------------------------------- */
+      if(d->rows < MAXROWS) {
+         d->hour[d->rows]    = x.hour;
+         d->minute[d->rows]  = x.minute;
+         d->dflag[d->rows]   = x.dflag;
+         d->azimuth[d->rows] = x.azimuth;
+         d->zenith[d->rows]  = x.zenith;
+         d->time[d->rows]    = x.time;
+         d->rows++;
+      }
+   }
+   /* -------------------------------------------------------- *
+    * pass on the last day                                     *
+    * -------------------------------------------------------- */
+   if(d->rows > 0 && (result = send_day(g)) != 0) return result;
+   return 0;
+}
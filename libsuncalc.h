@@ -0,0 +1,210 @@
+/* ------------------------------------------------------------ *
+ * file:        libsuncalc.h                                    *
+ * purpose:     sun position dataset generator, the calculation *
+ *              part of suncalc as a library: libsuncalc.a      *
+ *                                                              *
+ * A generator object holds all state of one calculation run,  *
+ * there are no globals. Several generators can run at the     *
+ * same time in different threads. The results are passed day  *
+ * by day to the sinks the caller registered, suncalc's sink   *
+ * writes the data files.                                       *
+ *                                                              *
+ * Days start at 00:00 in the local time of the process (TZ),   *
+ * the timezone in sunconf is the offset passed to the SPA.     *
+ * ------------------------------------------------------------ */
+#ifndef LIBSUNCALC_H
+#define LIBSUNCALC_H
+
+#include <stdint.h>
+#include <time.h>
+#include "spa.h"
+
+/* ------------------------------------------------------------ *
+ * drecord structure contains the daily sun min/max values      *
+ * and is stored in the yearly srs file. record size: 14 bytes  *
+ * transit elevation fits into int8_t, I use int16_t to avoid   *
+ * compiler padding to memory-align the structure.              *
+ * ------------------------------------------------------------ */
+struct drecord {
+   uint8_t month;                    // 1-12 month of the year
+   uint8_t day;                      // 1-31 day of the year
+   uint8_t risehour;                 // 0-23 sunrise hour
+   uint8_t riseminute;               // 0-59 sunrise minute
+   uint16_t riseazimuth;             // 0-359 (round to full degree to reduce datatype storage)
+   uint8_t transithour;              // 0-23 zenith peak hour
+   uint8_t transitminute;            // 0-59 zenit peak minute
+   int16_t transitelevation;         // -90..90 (max sun height, rounded to full degree)
+   uint8_t sethour;                  // 0-23 sunset hour
+   uint8_t setminute;                // 0-59 sunset minute
+   uint16_t setazimuth;              // 0-359 (see above)
+};
+
+/* ------------------------------------------------------------ *
+ * dayset structure buffers one day of calculated sun positions *
+ * as column arrays. MAXROWS covers 1 min interval over a 25h   *
+ * day, which happens on a DST switch back to standard time.    *
+ * ------------------------------------------------------------ */
+#define MAXROWS 1500
+struct dayset {
+   int year;                         // 4-digit year
+   int month;                        // 1-12 month of the year
+   int day;                          // 1-31 day of the month
+   int rows;                         // number of valid rows below
+   int64_t time[MAXROWS];            // unix time in seconds
+   uint8_t hour[MAXROWS];            // 0-23 day hour
+   uint8_t minute[MAXROWS];          // 0-59 day minute
+   uint8_t dflag[MAXROWS];           // 0 or 1 daylight or night flag
+   double azimuth[MAXROWS];          // azimuth angle
+   double zenith[MAXROWS];           // zenith angle
+   spa_data spa;                     // spa result at 00:00, has sunrise and sunset
+};
+
+/* ------------------------------------------------------------ *
+ * sunconf holds the generator input                            *
+ * ------------------------------------------------------------ */
+struct sunconf {
+   double longitude;                 // -180..180 degrees, east is positive
+   double latitude;                  // -90..90 degrees, north is positive
+   double timezone;                  // hours ahead of GMT, e.g. +9 for Japan
+   int interval;                     // 60..3600 seconds, a divisor of 86400
+   time_t start;                     // first day, 00:00 local time
+   time_t end;                       // end of the period, not included
+   int verbose;                      // print debug output to stdout
+};
+
+/* ------------------------------------------------------------ *
+ * sunsink receives the results. srs() is called at the start  *
+ * of each day, day() with the complete day. A nonzero return  *
+ * ends sungen_run() with that value. spaerror() is told about *
+ * SPA input errors, e.g. no sunrise in polar regions, and the *
+ * run continues. want() is asked after srs() if the sink needs *
+ * the day: when every sink with a day() has a want() that     *
+ * returns 0, the positions of the day are not calculated and  *
+ * day() is not called for it. Each function may be NULL.       *
+ * ------------------------------------------------------------ */
+struct sunsink {
+   void *ctx;                        // passed to the functions below
+   int (*srs)(void *ctx, const struct drecord *srs, int year, int yday);
+   int (*day)(void *ctx, const struct dayset *d);
+   void (*spaerror)(void *ctx, const spa_data *spa, int errcode);
+   int (*want)(void *ctx, int year, int month, int day);
+};
+
+/* ------------------------------------------------------------ *
+ * sungen is one generator, the caller owns the memory (~40KB)  *
+ * ------------------------------------------------------------ */
+#define SUNSINKS 8
+struct sungen {
+   struct sunconf conf;              // input of the run
+   spa_data spastart;                // spa input at the period start
+   int days;                         // number of days in the period
+   int nsinks;                       // registered sinks
+   struct sunsink sinks[SUNSINKS];   // result receivers
+   struct dayset day;                // the day being calculated
+};
+
+/* ------------------------------------------------------------ *
+ * sunsample is one position of a series                        *
+ * ------------------------------------------------------------ */
+struct sunsample {
+   int64_t time;                     // unix time in seconds
+   double azimuth;                   // azimuth angle
+   double zenith;                    // zenith angle
+   uint8_t dflag;                    // 0 or 1 daylight or night flag
+   uint8_t hour;                     // 0-23 local time of the sample
+   uint8_t minute;                   // 0-59
+   uint8_t second;                   // 0-59
+};
+
+/* ------------------------------------------------------------ *
+ * sunseries is a lazy iterator over the positions of a site    *
+ * from conf start to end, every conf interval seconds. It      *
+ * calculates SUNBATCH samples at a time when they are asked    *
+ * for, a batch ends before 00:00, so a batch is always of one  *
+ * day. The caller owns the memory (~4KB), it may stop at any   *
+ * sample. spaerror, if set, is told about SPA input errors.    *
+ * ------------------------------------------------------------ */
+#define SUNBATCH 64
+struct sunseries {
+   struct sunconf conf;              // site, interval and period
+   spa_data spa;                     // spa input, and result of the last sample
+   spa_data dayspa;                  // spa result at 00:00 of the current day
+   time_t next;                      // time of the next sample to calculate
+   time_t trise;                     // sunrise of the current day
+   time_t tset;                      // sunset of the current day
+   int pos;                          // next sample to return from batch
+   int count;                        // samples in batch
+   struct sunsample batch[SUNBATCH]; // calculated, not yet returned samples
+   void *ctx;                        // passed to spaerror
+   void (*spaerror)(void *ctx, const spa_data *spa, int errcode);
+};
+
+/* ------------------------------------------------------------ *
+ * sunseries_init() prepares a series for conf, returns 0, or   *
+ * -1 if the interval is invalid. sunseries_next() sets x to    *
+ * the next sample and returns 1, or returns 0 at the end.      *
+ * sunseries_day() is the SPA result at 00:00 of the day of the *
+ * last returned sample, it has the sunrise, transit, sunset.   *
+ * sunseries_skipday() drops the rest of that day, the next     *
+ * sample is 00:00 of the following day. The 00:00 sample ends  *
+ * its batch, so skipping right after it calculates nothing.   *
+ * ------------------------------------------------------------ */
+int sunseries_init(struct sunseries *s, const struct sunconf *conf);
+int sunseries_next(struct sunseries *s, struct sunsample *x);
+const spa_data *sunseries_day(const struct sunseries *s);
+void sunseries_skipday(struct sunseries *s);
+
+/* ------------------------------------------------------------ *
+ * sunpos is the sun position at one point in time              *
+ * ------------------------------------------------------------ */
+struct sunpos {
+   double azimuth;                   // 0..360 degrees, north is 0
+   double zenith;                    // 0..180 degrees
+   double elevation;                 // 90 - zenith
+   int dflag;                        // 1 between sunrise and sunset
+};
+
+/* ------------------------------------------------------------ *
+ * sun_position() calculates the position at time t for the     *
+ * site in conf, with one SPA call. interval, start and end of  *
+ * conf are not used. Returns 0, or the SPA error code.         *
+ * ------------------------------------------------------------ */
+int sun_position(const struct sunconf *conf, time_t t, struct sunpos *p);
+
+/* ------------------------------------------------------------ *
+ * sun_dayposition() interpolates the position at time t from   *
+ * the day table d, between the two records around t. Returns  *
+ * the day flag of the record before t.                         *
+ * ------------------------------------------------------------ */
+int sun_dayposition(const struct dayset *d, time_t t, double *azimuth, double *zenith);
+
+/* ------------------------------------------------------------ *
+ * sun_engine() describes the calculation: the fixed SPA input  *
+ * values, e.g. delta_t and atmos_refract. Two runs with the    *
+ * same engine and sunconf give the same positions.             *
+ * ------------------------------------------------------------ */
+const char *sun_engine(void);
+
+/* ------------------------------------------------------------ *
+ * sun_period() sets start and end for a period code, relative  *
+ * to the time now: nd|nm|nq|ny|td|tm|tq|ty|2y|tf, as suncalc  *
+ * -p. Returns 0, or -1 for an unknown period.                  *
+ * ------------------------------------------------------------ */
+int sun_period(const char *period, time_t now, time_t *start, time_t *end);
+
+/* ------------------------------------------------------------ *
+ * sungen_init() prepares a generator for conf, returns 0, or   *
+ * -1 if the interval is invalid. sungen_sink() adds a sink,    *
+ * returns 0, or -1 if there are already SUNSINKS sinks.        *
+ * ------------------------------------------------------------ */
+int sungen_init(struct sungen *g, const struct sunconf *conf);
+int sungen_sink(struct sungen *g, const struct sunsink *sink);
+
+/* ------------------------------------------------------------ *
+ * sungen_run() calculates the period and feeds the sinks, it   *
+ * is a consumer of a sunseries over the period.                *
+ * Returns 0, or the nonzero value a sink returned.             *
+ * ------------------------------------------------------------ */
+int sungen_run(struct sungen *g);
+
+#endif
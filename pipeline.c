@@ -0,0 +1,228 @@
+/* ------------------------------------------------------------ *
+ * file:        pipeline.c                                      *
+ * purpose:     generator and output stages of suncalc, see     *
+ *              pipeline.h                                      *
+ *                                                              *
+ * The compute thread is the only writer of head, the output   *
+ * stage the only writer of tail, so the ring needs no lock:   *
+ * a slot is filled before head moves past it (release), and  *
+ * read before tail moves past it. A stage that finds the ring *
+ * full or empty spins briefly, then sleeps, from 20us up to  *
+ * 1ms per check, so a waiting stage leaves the CPU to the     *
+ * other one also on a single core.                            *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // malloc
+#include <string.h>    // memcpy
+#include <stdatomic.h> // ring head and tail
+#include <pthread.h>   // compute thread
+#include <time.h>      // stage timing, nanosleep
+#include "libsuncalc.h" // dataset generator
+#include "pipeline.h"
+
+#define PIPESPIN 64                  // checks before a stage sleeps
+#define PIPESLEEP 1000000            // longest sleep per check in ns
+
+/* ------------------------------------------------------------ *
+ * pipeitem is one ring slot: a day and its srs record          *
+ * ------------------------------------------------------------ */
+struct pipeitem {
+   int hassrs;                       // 1 = srs below is valid
+   int hasday;                       // 1 = day below is valid, 0 = the sinks skipped it
+   int year;                         // srs() arguments
+   int yday;
+   struct drecord srs;
+   struct dayset day;
+};
+
+/* ------------------------------------------------------------ *
+ * pipe is the state of one pipeline_run()                      *
+ * ------------------------------------------------------------ */
+struct pipe {
+   struct pipeitem *ring;            // PIPESLOTS days
+   atomic_uint head;                 // next slot the compute stage fills
+   atomic_uint tail;                 // next slot the output stage reads
+   atomic_int done;                  // compute stage finished
+   atomic_int stop;                  // output stage failed, stop computing
+   int pendingsrs;                   // srs is in the head slot, its day follows
+   int result;                       // sungen_run() result
+   double computetime;               // compute thread run time
+   const struct sunsink *out;        // the output stage sink
+   struct sungen *g;                 // generator of the compute stage
+   struct pipestats *st;             // instrumentation
+};
+
+static double seconds() {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void backoff(int *spins) {
+   struct timespec pause = { 0, 20000 };
+   int n = ++(*spins) - PIPESPIN;
+
+   if(n <= 0) return;
+   if(n < 6) pause.tv_nsec <<= n;
+   else pause.tv_nsec = PIPESLEEP;
+   nanosleep(&pause, NULL);
+}
+
+/* ------------------------------------------------------------ *
+ * head_slot() returns the slot at head, after waiting for the  *
+ * output stage to free it. NULL if the output stage failed.    *
+ * ------------------------------------------------------------ */
+static struct pipeitem *head_slot(struct pipe *p) {
+   unsigned h = atomic_load_explicit(&p->head, memory_order_relaxed);
+   double t0;
+   int spins = 0;
+
+   if(h - atomic_load_explicit(&p->tail, memory_order_acquire) == PIPESLOTS) {
+      t0 = seconds();
+      while(h - atomic_load_explicit(&p->tail, memory_order_acquire) == PIPESLOTS) {
+         if(atomic_load_explicit(&p->stop, memory_order_relaxed)) return NULL;
+         backoff(&spins);
+      }
+      p->st->computewait += seconds() - t0;
+   }
+   return &p->ring[h % PIPESLOTS];
+}
+
+/* ------------------------------------------------------------ *
+ * pipe_srs(), pipe_day() and pipe_spaerror() are the generator *
+ * sink of the compute stage, they fill the head slot          *
+ * ------------------------------------------------------------ */
+static int pipe_srs(void *ctx, const struct drecord *srs, int year, int yday) {
+   struct pipe *p = ctx;
+   struct pipeitem *it = head_slot(p);
+
+   if(!it) return 1;
+   it->srs = *srs;
+   it->year = year;
+   it->yday = yday;
+   p->pendingsrs = 1;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * push_slot() passes the head slot on to the output stage      *
+ * ------------------------------------------------------------ */
+static void push_slot(struct pipe *p, struct pipeitem *it, int hasday) {
+   unsigned h;
+   int depth;
+
+   it->hassrs = p->pendingsrs;
+   it->hasday = hasday;
+   p->pendingsrs = 0;
+   h = atomic_load_explicit(&p->head, memory_order_relaxed) + 1;
+   atomic_store_explicit(&p->head, h, memory_order_release);
+   depth = h - atomic_load_explicit(&p->tail, memory_order_acquire);
+   p->st->pushes++;
+   p->st->depthsum += depth;
+   if(depth > p->st->depthmax) p->st->depthmax = depth;
+}
+
+static int pipe_day(void *ctx, const struct dayset *d) {
+   struct pipe *p = ctx;
+   struct pipeitem *it = head_slot(p);
+   int n = d->rows;
+
+   if(!it) return 1;
+   it->day.year  = d->year;
+   it->day.month = d->month;
+   it->day.day   = d->day;
+   it->day.rows  = n;
+   it->day.spa   = d->spa;
+   memcpy(it->day.time, d->time, n * sizeof(d->time[0]));
+   memcpy(it->day.hour, d->hour, n);
+   memcpy(it->day.minute, d->minute, n);
+   memcpy(it->day.dflag, d->dflag, n);
+   memcpy(it->day.azimuth, d->azimuth, n * sizeof(d->azimuth[0]));
+   memcpy(it->day.zenith, d->zenith, n * sizeof(d->zenith[0]));
+   push_slot(p, it, 1);
+   return 0;
+}
+
+static void pipe_spaerror(void *ctx, const spa_data *spa, int errcode) {
+   const struct sunsink *out = ((struct pipe *) ctx)->out;
+
+   if(out->spaerror) out->spaerror(out->ctx, spa, errcode);
+}
+
+/* ------------------------------------------------------------ *
+ * pipe_want() asks the output sink, a day it skips still passes *
+ * its srs record on, in a slot without day                     *
+ * ------------------------------------------------------------ */
+static int pipe_want(void *ctx, int year, int month, int day) {
+   struct pipe *p = ctx;
+   struct pipeitem *it;
+
+   if(!p->out->want || p->out->want(p->out->ctx, year, month, day)) return 1;
+   if(p->pendingsrs && (it = head_slot(p)) != NULL) push_slot(p, it, 0);
+   return 0;
+}
+
+static void *compute_thread(void *arg) {
+   struct pipe *p = arg;
+   double t0 = seconds();
+
+   p->result = sungen_run(p->g);
+   p->computetime = seconds() - t0;
+   atomic_store_explicit(&p->done, 1, memory_order_release);
+   return NULL;
+}
+
+/* ------------------------------------------------------------ *
+ * pipeline_run() is the output stage, it takes the days from   *
+ * the tail of the ring                                         *
+ * ------------------------------------------------------------ */
+int pipeline_run(struct sungen *g, const struct sunsink *out, struct pipestats *st) {
+   struct pipe p = { .out = out, .g = g, .st = st };
+   struct sunsink sink = { &p, pipe_srs, pipe_day, pipe_spaerror, pipe_want };
+   struct pipeitem *it;
+   pthread_t tid;
+   double t0, w0, total;
+   unsigned t;
+   int result = 0, spins;
+
+   memset(st, 0, sizeof(*st));
+   if(!(p.ring = malloc(PIPESLOTS * sizeof(struct pipeitem)))) return -1;
+   atomic_init(&p.head, 0);
+   atomic_init(&p.tail, 0);
+   atomic_init(&p.done, 0);
+   atomic_init(&p.stop, 0);
+   sungen_sink(g, &sink);
+
+   t0 = seconds();
+   if(pthread_create(&tid, NULL, compute_thread, &p) != 0) {
+      free(p.ring);
+      return -1;
+   }
+   for(;;) {
+      t = atomic_load_explicit(&p.tail, memory_order_relaxed);
+      if(atomic_load_explicit(&p.head, memory_order_acquire) == t) {
+         w0 = seconds();
+         spins = 0;
+         while(atomic_load_explicit(&p.head, memory_order_acquire) == t &&
+               !atomic_load_explicit(&p.done, memory_order_acquire)) backoff(&spins);
+         st->outputwait += seconds() - w0;
+         if(atomic_load_explicit(&p.head, memory_order_acquire) == t) break; // done, and nothing left
+      }
+      it = &p.ring[t % PIPESLOTS];
+      if(it->hassrs && out->srs && (result = out->srs(out->ctx, &it->srs, it->year, it->yday)) != 0) break;
+      if(it->hasday) {
+         if(out->day && (result = out->day(out->ctx, &it->day)) != 0) break;
+         st->days++;
+         st->rows += it->day.rows;
+      }
+      atomic_store_explicit(&p.tail, t + 1, memory_order_release);
+   }
+   if(result != 0) atomic_store_explicit(&p.stop, 1, memory_order_relaxed);
+   pthread_join(tid, NULL);
+   total = seconds() - t0;
+
+   st->computebusy = p.computetime - st->computewait;
+   st->outputbusy = total - st->outputwait;
+   free(p.ring);
+   return result != 0 ? result : p.result;
+}
@@ -0,0 +1,47 @@
+/* ------------------------------------------------------------ *
+ * file:        pipeline.h                                      *
+ * purpose:     runs the generator and the file output of       *
+ *              suncalc as two pipeline stages, connected by a  *
+ *              bounded lock-free single producer single        *
+ *              consumer ring of days.                          *
+ * ------------------------------------------------------------ */
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "libsuncalc.h"
+
+/* ------------------------------------------------------------ *
+ * ring slots, one day each (~40KB)                             *
+ * ------------------------------------------------------------ */
+#define PIPESLOTS 8
+
+/* ------------------------------------------------------------ *
+ * pipestats is the stage instrumentation. busy is the time a   *
+ * stage worked, without the time it waited for the other one: *
+ * a full ring stalls the compute stage, an empty ring stalls  *
+ * the output stage. depth is sampled after each slot is queued,*
+ * srs-only slots of cached days included.                      *
+ * ------------------------------------------------------------ */
+struct pipestats {
+   long days;                        // days passed through the ring
+   long rows;                        // positions in these days
+   double computebusy;               // seconds the compute stage worked
+   double computewait;               // seconds it waited for a free slot
+   double outputbusy;                // seconds the output stage worked
+   double outputwait;                // seconds it waited for a day
+   long pushes;                      // slots queued, days and srs-only
+   double depthsum;                  // sum of the sampled queue depths
+   int depthmax;                     // highest queue depth
+};
+
+/* ------------------------------------------------------------ *
+ * pipeline_run() runs g in a compute thread. Each day goes     *
+ * through the ring to the calling thread, which passes it on   *
+ * to the srs() and day() of out, in the same order as a       *
+ * sungen_sink() of out would. out->spaerror is called from the *
+ * compute thread. g must not have sinks yet. Returns the      *
+ * sungen_run() result, or the first nonzero out result.        *
+ * ------------------------------------------------------------ */
+int pipeline_run(struct sungen *g, const struct sunsink *out, struct pipestats *st);
+
+#endif
@@ -0,0 +1,372 @@
+/* ------------------------------------------------------------ *
+ * file:        serial.c                                        *
+ * purpose:     real-time position stream for suncalc --stream, *
+ *              see serial.h                                    *
+ *                                                              *
+ * The frames of today and tomorrow are built ahead, with their *
+ * CRC, so a send is one write() of a ready buffer. Tomorrow is *
+ * calculated right after the day switch, while the link waits  *
+ * for the next boundary. The device is non-blocking: a frame   *
+ * the link cannot take is dropped, the next one is current     *
+ * again. Incoming bytes are scanned for resync frames.         *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // malloc
+#include <stdio.h>     // status output
+#include <string.h>    // memcpy
+#include <stdint.h>    // uint8_t data type
+#include <unistd.h>    // read, write, close
+#include <fcntl.h>     // open flags
+#include <errno.h>     // EAGAIN
+#include <signal.h>    // shutdown signals
+#include <poll.h>      // wait for boundary or input
+#include <termios.h>   // raw tty
+#include <time.h>      // boundaries, send delay
+#include "libsuncalc.h" // dataset generator
+#include "serial.h"
+
+#define HELLOLEN 16                  // hello payload bytes
+#define SRSLEN   18                  // srs payload bytes: time + drecord
+#define POSLEN   23                  // pos payload bytes: time + 19 byte day record
+#define FRAME(n) ((n) + 6)           // sync, type, length, payload, crc
+
+/* ------------------------------------------------------------ *
+ * linkday is one day of ready frames                           *
+ * ------------------------------------------------------------ */
+struct linkday {
+   time_t start;                     // 00:00 local time
+   int rows;                         // number of pos frames
+   time_t time[MAXROWS];             // send time of each pos frame
+   uint8_t srs[FRAME(SRSLEN)];
+   uint8_t pos[MAXROWS][FRAME(POSLEN)];
+};
+
+static volatile sig_atomic_t stop = 0; // set by SIGINT and SIGTERM
+static int debug = 0;                // verbose output
+static long sent = 0, sentbytes = 0, dropped = 0, resyncs = 0, ontime = 0;
+static int reopens = 0;              // failed opens since the link was lost
+static double latemax = 0, latesum = 0; // send delay of the ontime boundary records, ms
+
+static void on_signal(int sig) {
+   stop = 1;
+}
+
+/* ------------------------------------------------------------ *
+ * crc16() is CRC-16/CCITT-FALSE: polynom 0x1021, init 0xffff   *
+ * ------------------------------------------------------------ */
+static uint16_t crc16(const uint8_t *p, int len) {
+   uint16_t crc = 0xffff;
+   int b;
+
+   while(len-- > 0) {
+      crc ^= (uint16_t) *p++ << 8;
+      for(b = 0; b < 8; b++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+   }
+   return crc;
+}
+
+/* ------------------------------------------------------------ *
+ * frame() puts the header and crc around the len payload bytes *
+ * already at f + 4                                             *
+ * ------------------------------------------------------------ */
+static int frame(uint8_t *f, uint8_t type, int len) {
+   uint16_t crc;
+
+   f[0] = SERIAL_SYNC0;
+   f[1] = SERIAL_SYNC1;
+   f[2] = type;
+   f[3] = len;
+   crc = crc16(f + 2, len + 2);
+   f[4 + len] = crc & 0xff;
+   f[5 + len] = crc >> 8;
+   return FRAME(len);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+   p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+/* ------------------------------------------------------------ *
+ * link_srs() and link_day() are the generator sink that builds *
+ * the frames of a day                                          *
+ * ------------------------------------------------------------ */
+static int link_srs(void *ctx, const struct drecord *srs, int year, int yday) {
+   struct linkday *ld = ctx;
+
+   put32(ld->srs + 4, (uint32_t) ld->start);
+   memcpy(ld->srs + 8, srs, sizeof(*srs));
+   frame(ld->srs, SERIAL_SRS, SRSLEN);
+   return 0;
+}
+
+static int link_day(void *ctx, const struct dayset *d) {
+   struct linkday *ld = ctx;
+   uint8_t *p;
+   int r;
+
+   for(r = 0; r < d->rows; r++) {
+      p = ld->pos[r] + 4;
+      put32(p, (uint32_t) d->time[r]);
+      p[4] = d->hour[r];
+      p[5] = d->minute[r];
+      p[6] = d->dflag[r];
+      memcpy(p + 7, &d->azimuth[r], sizeof(double));
+      memcpy(p + 15, &d->zenith[r], sizeof(double));
+      frame(ld->pos[r], SERIAL_POS, POSLEN);
+      ld->time[r] = d->time[r];
+   }
+   ld->rows = d->rows;
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * calc_linkday() builds the frames of the day starting at the  *
+ * local 00:00 of t, plus add days                              *
+ * ------------------------------------------------------------ */
+static void calc_linkday(struct linkday *ld, const struct sunconf *site, time_t t, int add) {
+   struct sunconf conf = *site;
+   struct sunsink sink = { ld, link_srs, link_day, NULL };
+   struct sungen *g;
+   struct tm tm;
+
+   localtime_r(&t, &tm);
+   tm.tm_mday += add;
+   tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+   tm.tm_isdst = -1;
+   ld->start = conf.start = mktime(&tm);
+   tm.tm_mday += 1;
+   tm.tm_isdst = -1;
+   conf.end = mktime(&tm);
+   conf.verbose = 0;
+   ld->rows = 0;
+   if(! (g = malloc(sizeof(struct sungen)))) return;
+   if(sungen_init(g, &conf) == 0) {
+      sungen_sink(g, &sink);
+      sungen_run(g);
+   }
+   free(g);
+   localtime_r(&ld->start, &tm);
+   if(debug) printf("Debug: frames of day %04d-%02d-%02d ready, %d records\n",
+                    tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, ld->rows);
+}
+
+/* ------------------------------------------------------------ *
+ * open_link() opens dev, non-blocking, a tty in raw mode.      *
+ * Returns the descriptor, or -1.                               *
+ * ------------------------------------------------------------ */
+static int open_link(const char *dev) {
+   struct termios tio;
+   int fd;
+
+   if((fd = open(dev, O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0) return -1;
+   if(isatty(fd) && tcgetattr(fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      cfsetispeed(&tio, B115200);
+      cfsetospeed(&tio, B115200);
+      tio.c_cflag |= CLOCAL | CREAD;
+      tcsetattr(fd, TCSANOW, &tio);
+      tcflush(fd, TCIOFLUSH);
+   }
+   return fd;
+}
+
+/* ------------------------------------------------------------ *
+ * send_frame() writes one frame, returns 0, 1 if the link had  *
+ * no room and the frame was dropped, or -1 if the link is lost *
+ * ------------------------------------------------------------ */
+static int send_frame(int fd, const uint8_t *f) {
+   int len = FRAME(f[3]);
+   ssize_t n = write(fd, f, len);
+
+   if(n == len) {
+      sent++;
+      sentbytes += len;
+      return 0;
+   }
+   if(n >= 0 || errno == EAGAIN || errno == EINTR) {
+      dropped++;
+      return 1;
+   }
+   return -1;
+}
+
+/* ------------------------------------------------------------ *
+ * send_resync() sends hello, the day's srs and the record of   *
+ * the current interval r, the state a tracker starts from      *
+ * ------------------------------------------------------------ */
+static int send_resync(int fd, const struct sunconf *conf, const struct linkday *ld, int r) {
+   uint8_t hello[FRAME(HELLOLEN)] = { 0 };
+   float f;
+
+   hello[4] = SERIAL_VERSION;
+   hello[6] = conf->interval & 0xff;
+   hello[7] = conf->interval >> 8;
+   f = conf->longitude;
+   memcpy(hello + 8, &f, sizeof(f));
+   f = conf->latitude;
+   memcpy(hello + 12, &f, sizeof(f));
+   f = conf->timezone;
+   memcpy(hello + 16, &f, sizeof(f));
+   frame(hello, SERIAL_HELLO, HELLOLEN);
+   if(send_frame(fd, hello) < 0 || send_frame(fd, ld->srs) < 0) return -1;
+   return r >= 0 && r < ld->rows ? send_frame(fd, ld->pos[r]) : 0;
+}
+
+/* ------------------------------------------------------------ *
+ * read_commands() scans the incoming bytes for resync frames.  *
+ * Returns 1 if one came, 0 if not, -1 if the link is lost.     *
+ * ------------------------------------------------------------ */
+static int read_commands(int fd) {
+   static uint8_t in[64];
+   static int have = 0;
+   uint8_t buf[256];
+   ssize_t n;
+   int i, resync = 0;
+
+   if((n = read(fd, buf, sizeof(buf))) < 0) return errno == EAGAIN || errno == EINTR ? 0 : -1;
+   if(n == 0) return -1;
+   for(i = 0; i < n; i++) {
+      if(have == 0 && buf[i] != SERIAL_SYNC0) continue;
+      if(have == 1 && buf[i] != SERIAL_SYNC1) {
+         have = buf[i] == SERIAL_SYNC0;
+         continue;
+      }
+      in[have++] = buf[i];
+      if(have < 4 || have < FRAME(in[3])) {
+         if(have < (int) sizeof(in)) continue;
+         have = 0;                  // too long for a command
+         continue;
+      }
+      if(crc16(in + 2, in[3] + 2) == (in[4 + in[3]] | in[5 + in[3]] << 8) && in[2] == SERIAL_RESYNC) resync = 1;
+      else if(debug) printf("Debug: ignored frame type 0x%02x length %d\n", in[2], in[3]);
+      have = 0;
+   }
+   return resync;
+}
+
+/* ------------------------------------------------------------ *
+ * lose_link() closes a failed link, it is opened again after a *
+ * second                                                       *
+ * ------------------------------------------------------------ */
+static int lose_link(int fd, const char *dev) {
+   printf("Lost link [%s]\n", dev);
+   fflush(stdout);
+   close(fd);
+   reopens = 0;
+   sleep(1);
+   return -1;
+}
+
+static double now_ms() {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* ------------------------------------------------------------ *
+ * serial_run() is the send loop: wait for the boundary of row  *
+ * r or input, send, and switch days at the end of today        *
+ * ------------------------------------------------------------ */
+int serial_run(const char *dev, const struct sunconf *conf, int verbose) {
+   struct linkday *today, *tomorrow, *swap;
+   struct pollfd pfd;
+   double late, wait;
+   time_t now;
+   int fd = -1, r, c;
+
+   if(conf->interval < 60 || conf->interval > 3600 || 86400 % conf->interval != 0) return -1;
+   debug = verbose;
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+   signal(SIGPIPE, SIG_IGN);
+   today = malloc(sizeof(struct linkday));
+   tomorrow = malloc(sizeof(struct linkday));
+   if(!today || !tomorrow) return -1;
+
+   now = time(NULL);
+   calc_linkday(today, conf, now, 0);
+   calc_linkday(tomorrow, conf, now, 1);
+   for(r = 0; r < today->rows && today->time[r] <= now; r++);
+   printf("Stream to [%s], %d second records\n", dev, conf->interval);
+   fflush(stdout);
+
+   while(!stop) {
+      /* -------------------------------------------------------- *
+       * at the end of today, tomorrow becomes today              *
+       * -------------------------------------------------------- */
+      if(r >= today->rows) {
+         swap = today;
+         today = tomorrow;
+         tomorrow = swap;
+         calc_linkday(tomorrow, conf, today->start, 1);
+         for(r = 0; r < today->rows && today->time[r] < time(NULL); r++);
+         if(r > 0) {                   // resumed after a stall: srs and the current record
+            r--;
+            if(fd >= 0) send_frame(fd, today->srs);
+         }
+         continue;
+      }
+      /* -------------------------------------------------------- *
+       * open the link, a tracker starts from a resync            *
+       * -------------------------------------------------------- */
+      if(fd < 0) {
+         if((fd = open_link(dev)) < 0) {
+            if(reopens++ == 0) {
+               printf("Waiting for [%s]\n", dev);
+               fflush(stdout);
+            }
+            sleep(1);
+            continue;
+         }
+         if(debug) printf("Debug: link [%s] open\n", dev);
+         for(now = time(NULL); r < today->rows && today->time[r] <= now; r++);
+         if(send_resync(fd, conf, today, r - 1) < 0) fd = lose_link(fd, dev);
+         continue;
+      }
+      /* -------------------------------------------------------- *
+       * wait for the boundary, or a command from the tracker     *
+       * -------------------------------------------------------- */
+      wait = today->time[r] * 1000.0 - now_ms();
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if(wait > 0) {
+         if(poll(&pfd, 1, wait > 1000 ? 1000 : (int) wait + 1) > 0) {
+            c = pfd.revents & (POLLERR | POLLHUP | POLLNVAL) ? -1 : read_commands(fd);
+            if(c == 1) {
+               resyncs++;
+               if(debug) printf("Debug: resync\n");
+               c = send_resync(fd, conf, today, r - 1) < 0 ? -1 : 0;
+            }
+            if(c < 0) fd = lose_link(fd, dev);
+         }
+         continue;
+      }
+      /* -------------------------------------------------------- *
+       * send the record of the boundary, and the srs at 00:00.   *
+       * A boundary missed by more than an interval is skipped.   *
+       * -------------------------------------------------------- */
+      late = -wait;
+      if(late > conf->interval * 1000.0 && r + 1 < today->rows && today->time[r + 1] * 1000.0 <= now_ms()) {
+         r++;
+         continue;
+      }
+      c = r == 0 ? send_frame(fd, today->srs) : 0;
+      if(c >= 0) c = send_frame(fd, today->pos[r]);
+      if(c < 0) {
+         fd = lose_link(fd, dev);
+         continue;
+      }
+      if(late > latemax) latemax = late;
+      latesum += late;
+      ontime++;
+      if(debug) printf("Debug: sent record %d time %lld late %.1fms\n", r, (long long) today->time[r], late);
+      r++;
+   }
+   if(fd >= 0) close(fd);
+   printf("Stream: %ld frames %ld bytes sent, %ld dropped, %ld resyncs, send delay avg %.2fms max %.2fms\n",
+          sent, sentbytes, dropped, resyncs, ontime > 0 ? latesum / ontime : 0.0, latemax);
+   free(today);
+   free(tomorrow);
+   return 0;
+}
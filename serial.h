@@ -0,0 +1,35 @@
+/* ------------------------------------------------------------ *
+ * file:        serial.h                                        *
+ * purpose:     real-time position stream to a tracker on a     *
+ *              serial or USB CDC link for suncalc --stream,    *
+ *              one framed day record per interval, sent on the *
+ *              wall-clock interval boundary.                   *
+ * ------------------------------------------------------------ */
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "libsuncalc.h"
+
+/* ------------------------------------------------------------ *
+ * frame layout, see fileformat.md: sync "SC", type, payload    *
+ * length, payload, CRC-16/CCITT of type to the payload end.    *
+ * ------------------------------------------------------------ */
+#define SERIAL_SYNC0   'S'
+#define SERIAL_SYNC1   'C'
+#define SERIAL_HELLO   'H'           // host: protocol version and site
+#define SERIAL_SRS     'D'           // host: day start and srs record
+#define SERIAL_POS     'P'           // host: time and day file record
+#define SERIAL_RESYNC  'R'           // tracker: send hello, srs and position now
+
+#define SERIAL_VERSION 1             // protocol version in the hello frame
+
+/* ------------------------------------------------------------ *
+ * serial_run() opens the device dev, a tty is set to raw       *
+ * 115200 baud, and sends the position record of the site in    *
+ * conf at every interval boundary, until SIGINT or SIGTERM. A  *
+ * lost link is opened again every second. conf start and end   *
+ * are not used. Returns 0, or -1 if the interval is invalid.   *
+ * ------------------------------------------------------------ */
+int serial_run(const char *dev, const struct sunconf *conf, int verbose);
+
+#endif
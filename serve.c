@@ -0,0 +1,515 @@
+/* ------------------------------------------------------------ *
+ * file:        serve.c                                         *
+ * purpose:     position service for suncalc --serve, see       *
+ *              serve.h                                         *
+ *                                                              *
+ * Requests are one text line, on the unix socket a client can  *
+ * send any number of them over one connection:                 *
+ * pos <longitude> <latitude> <tz> <yyyy-mm-ddThh:mm:ss> [i]    *
+ * day <longitude> <latitude> <tz> <yyyymmdd> [interval]        *
+ * srs <longitude> <latitude> <tz> <yyyymmdd>                   *
+ * stats                                                        *
+ * The answer is "OK <n>" and n lines of csv data, the same as  *
+ * in the data files, or "ERR <message>". The HTTP listener     *
+ * takes GET /pos?x=&y=&t=&at=&i=, /day?x=&y=&t=&date=&i=,      *
+ * /srs?x=&y=&t=&date= and /stats, and returns the csv lines.   *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // malloc, qsort
+#include <stdio.h>     // snprintf
+#include <stdarg.h>    // error messages
+#include <stddef.h>    // offsetof
+#include <stdint.h>    // uint32_t data type
+#include <string.h>    // request parsing
+#include <unistd.h>    // read, write, close
+#include <errno.h>     // EINTR
+#include <signal.h>    // shutdown signals
+#include <poll.h>      // listener sockets
+#include <pthread.h>   // client threads, cache lock
+#include <time.h>      // request times, latency
+#include <sys/stat.h>  // stale socket file check
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "libsuncalc.h" // dataset generator
+#include "serve.h"
+
+/* ------------------------------------------------------------ *
+ * dayentry is one cached day table. The cache is small enough  *
+ * for a linear search, lastuse picks the least recently used   *
+ * entry to replace. lastuse 0 marks a free entry.              *
+ * ------------------------------------------------------------ */
+struct dayentry {
+   double longitude;                 // site
+   double latitude;
+   double timezone;
+   int date;                         // yyyymmdd
+   int interval;                     // seconds between records
+   unsigned long lastuse;            // use counter of the last hit
+   struct drecord srs;               // the day's srs record
+   struct dayset day;                // the day table
+};
+
+static struct dayentry *cache = NULL; // day table cache
+static int cachesize = 0;            // cache entries
+static unsigned long usecount = 0;   // cache use counter
+static long hits = 0, misses = 0;    // cache lookups
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ------------------------------------------------------------ *
+ * request latency in microseconds, the last LATSAMPLES requests *
+ * ------------------------------------------------------------ */
+#define LATSAMPLES 8192
+static uint32_t latency[LATSAMPLES];
+static long requests = 0;
+
+static volatile sig_atomic_t stop = 0; // set by SIGINT and SIGTERM
+static int debug = 0;                // verbose output
+
+#define MAXANSWER 65536              // a 1500 row day table fits
+#define MAXREQUEST 4096
+
+/* ------------------------------------------------------------ *
+ * calc_srs() and calc_day() are the generator sink that copies *
+ * the calculated day into a cache entry                        *
+ * ------------------------------------------------------------ */
+static int calc_srs(void *ctx, const struct drecord *srs, int year, int yday) {
+   ((struct dayentry *) ctx)->srs = *srs;
+   return 0;
+}
+
+static int calc_day(void *ctx, const struct dayset *d) {
+   memcpy(&((struct dayentry *) ctx)->day, d, sizeof(*d));
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * day_start() returns 00:00 local time of the date yyyymmdd,   *
+ * plus add days                                                *
+ * ------------------------------------------------------------ */
+static time_t day_start(int date, int add) {
+   struct tm tm = {0};
+
+   tm.tm_year  = date / 10000 - 1900;
+   tm.tm_mon   = date / 100 % 100 - 1;
+   tm.tm_mday  = date % 100 + add;
+   tm.tm_isdst = -1;
+   return mktime(&tm);
+}
+
+/* ------------------------------------------------------------ *
+ * calc_entry() calculates the day of the entry key, returns 0, *
+ * or -1 if the generator rejects the input                     *
+ * ------------------------------------------------------------ */
+static int calc_entry(struct dayentry *e) {
+   struct sunconf conf = { e->longitude, e->latitude, e->timezone, e->interval,
+                           day_start(e->date, 0), day_start(e->date, 1), 0 };
+   struct sunsink sink = { e, calc_srs, calc_day, NULL };
+   struct sungen *g;
+   int result = -1;
+
+   e->day.rows = 0;
+   if(! (g = malloc(sizeof(struct sungen)))) return -1;
+   if(sungen_init(g, &conf) == 0) {
+      sungen_sink(g, &sink);
+      sungen_run(g);
+      if(e->day.rows > 0) result = 0;
+   }
+   free(g);
+   return result;
+}
+
+static int same_key(const struct dayentry *a, const struct dayentry *b) {
+   return a->longitude == b->longitude && a->latitude == b->latitude && a->timezone == b->timezone &&
+          a->date == b->date && a->interval == b->interval;
+}
+
+/* ------------------------------------------------------------ *
+ * get_day() fills e with the day table of its key, from the    *
+ * cache or newly calculated. The calculation runs without the  *
+ * lock, so other clients are not held up by a cache miss.      *
+ * ------------------------------------------------------------ */
+static int get_day(struct dayentry *e) {
+   int i, victim = 0;
+
+   pthread_mutex_lock(&lock);
+   for(i = 0; i < cachesize; i++) {
+      if(cache[i].lastuse > 0 && same_key(&cache[i], e)) {
+         cache[i].lastuse = ++usecount;
+         memcpy(e, &cache[i], sizeof(*e));
+         hits++;
+         pthread_mutex_unlock(&lock);
+         return 0;
+      }
+   }
+   misses++;
+   pthread_mutex_unlock(&lock);
+
+   if(calc_entry(e) != 0) return -1;
+
+   pthread_mutex_lock(&lock);
+   for(i = 0; i < cachesize; i++) {
+      if(cache[i].lastuse == 0 || same_key(&cache[i], e)) {
+         victim = i;
+         break;
+      }
+      if(cache[i].lastuse < cache[victim].lastuse) victim = i;
+   }
+   e->lastuse = ++usecount;
+   memcpy(&cache[victim], e, sizeof(*e));
+   pthread_mutex_unlock(&lock);
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * percentile() returns the p-th percentile of n sorted values  *
+ * ------------------------------------------------------------ */
+static int cmp_u32(const void *a, const void *b) {
+   uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+   return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const uint32_t *v, long n, int p) {
+   if(n == 0) return 0;
+   return v[(n - 1) * p / 100];
+}
+
+/* ------------------------------------------------------------ *
+ * stats_lines() writes the request statistics into out, 3 lines *
+ * ------------------------------------------------------------ */
+static int stats_lines(char *out, size_t size) {
+   static uint32_t sorted[LATSAMPLES];
+   long n, req, h, m;
+   int used = 0, i;
+
+   pthread_mutex_lock(&lock);
+   req = requests;
+   h = hits;
+   m = misses;
+   n = req < LATSAMPLES ? req : LATSAMPLES;
+   memcpy(sorted, latency, n * sizeof(uint32_t));
+   for(i = 0; i < cachesize; i++) if(cache[i].lastuse > 0) used++;
+   qsort(sorted, n, sizeof(uint32_t), cmp_u32);
+   snprintf(out, size, "requests,%ld\ncache,%d,%d,%ld,%ld\nlatency,%u,%u\n", req, used, cachesize,
+                h, m, percentile(sorted, n, 50), percentile(sorted, n, 99));
+   pthread_mutex_unlock(&lock);
+   return 3;
+}
+
+/* ------------------------------------------------------------ *
+ * site_ok() checks the site values of a request                *
+ * ------------------------------------------------------------ */
+static int site_ok(double lon, double lat, double tz) {
+   return lon >= -180 && lon <= 180 && lat >= -90 && lat <= 90 && tz >= -11 && tz <= 11;
+}
+
+/* ------------------------------------------------------------ *
+ * fail() writes an error message into out, returns -1          *
+ * ------------------------------------------------------------ */
+static int fail(char *out, size_t size, const char *fmt, ...) {
+   va_list ap;
+
+   va_start(ap, fmt);
+   vsnprintf(out, size, fmt, ap);
+   va_end(ap);
+   return -1;
+}
+
+/* ------------------------------------------------------------ *
+ * answer() handles one request line, e is the client's day     *
+ * table buffer. It writes the csv lines into out and returns   *
+ * their number, or -1 with the error message in out.           *
+ * ------------------------------------------------------------ */
+static int answer(const char *req, struct dayentry *e, char *out, size_t size) {
+   char cmd[8];
+   int y, mo, d, h, mi, s, n, r;
+   size_t len = 0;
+   double az, ze;
+
+   memset(e, 0, offsetof(struct dayentry, srs));
+   e->interval = 60;
+   if(sscanf(req, "%7s", cmd) != 1) return fail(out, size, "empty request");
+   if(strcmp(cmd, "stats") == 0) return stats_lines(out, size);
+   if(strcmp(cmd, "pos") == 0) {
+      n = sscanf(req, "%*s %lf %lf %lf %d-%d-%dT%d:%d:%d %d", &e->longitude, &e->latitude, &e->timezone,
+                 &y, &mo, &d, &h, &mi, &s, &e->interval);
+      if(n < 9) return fail(out, size, "usage: pos <longitude> <latitude> <tz> <yyyy-mm-ddThh:mm:ss> [interval]");
+      e->date = y * 10000 + mo * 100 + d;
+   }
+   else if(strcmp(cmd, "day") == 0 || strcmp(cmd, "srs") == 0) {
+      n = sscanf(req, "%*s %lf %lf %lf %d %d", &e->longitude, &e->latitude, &e->timezone, &e->date, &e->interval);
+      if(n < 4) return fail(out, size, "usage: %s <longitude> <latitude> <tz> <yyyymmdd>%s", cmd,
+                            strcmp(cmd, "day") == 0 ? " [interval]" : "");
+   }
+   else return fail(out, size, "unknown request %s", cmd);
+
+   if(! site_ok(e->longitude, e->latitude, e->timezone))
+      return fail(out, size, "invalid longitude, latitude or timezone");
+   if(e->date < 19000101 || e->date % 100 < 1 || e->date % 100 > 31 ||
+      e->date / 100 % 100 < 1 || e->date / 100 % 100 > 12)
+      return fail(out, size, "invalid date %d", e->date);
+   if(get_day(e) != 0) return fail(out, size, "invalid interval %d", e->interval);
+
+   if(strcmp(cmd, "pos") == 0) {
+      struct tm tm = { .tm_year = y - 1900, .tm_mon = mo - 1, .tm_mday = d,
+                       .tm_hour = h, .tm_min = mi, .tm_sec = s, .tm_isdst = -1 };
+      r = sun_dayposition(&e->day, mktime(&tm), &az, &ze);
+      snprintf(out, size, "%04d-%02d-%02dT%02d:%02d:%02d,%d,%.3f,%.3f\n", y, mo, d, h, mi, s, r, az, ze);
+      return 1;
+   }
+   if(strcmp(cmd, "srs") == 0) {
+      snprintf(out, size, "%04d-%02d-%02d,%02d:%02d,%d,%02d:%02d,%d,%02d:%02d,%d\n",
+               e->date / 10000, e->srs.month, e->srs.day,
+               e->srs.risehour, e->srs.riseminute, e->srs.riseazimuth,
+               e->srs.transithour, e->srs.transitminute, e->srs.transitelevation,
+               e->srs.sethour, e->srs.setminute, e->srs.setazimuth);
+      return 1;
+   }
+   for(r = 0; r < e->day.rows && len < size; r++) {
+      len += snprintf(out + len, size - len, "%02d:%02d,%d,%.3f,%.3f\n",
+                      e->day.hour[r], e->day.minute[r], e->day.dflag[r], e->day.azimuth[r], e->day.zenith[r]);
+   }
+   return e->day.rows;
+}
+
+/* ------------------------------------------------------------ *
+ * timed_answer() runs answer() and notes its latency           *
+ * ------------------------------------------------------------ */
+static int timed_answer(const char *req, struct dayentry *e, char *out, size_t size) {
+   struct timespec a, b;
+   int lines;
+
+   clock_gettime(CLOCK_MONOTONIC, &a);
+   lines = answer(req, e, out, size);
+   clock_gettime(CLOCK_MONOTONIC, &b);
+   pthread_mutex_lock(&lock);
+   latency[requests % LATSAMPLES] = (b.tv_sec - a.tv_sec) * 1000000 + (b.tv_nsec - a.tv_nsec) / 1000;
+   requests++;
+   pthread_mutex_unlock(&lock);
+   if(debug) printf("Debug: request [%s] lines [%d]\n", req, lines);
+   return lines;
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+   ssize_t n;
+
+   while(len > 0) {
+      if((n = write(fd, buf, len)) < 0) {
+         if(errno == EINTR) continue;
+         return -1;
+      }
+      buf += n;
+      len -= n;
+   }
+   return 0;
+}
+
+/* ------------------------------------------------------------ *
+ * unix_client() answers the request lines of one unix socket   *
+ * client, until it closes the connection                       *
+ * ------------------------------------------------------------ */
+static void unix_client(int fd, struct dayentry *e, char *out) {
+   char req[MAXREQUEST], head[32];
+   size_t have = 0;
+   ssize_t n;
+   char *nl;
+   int lines;
+
+   while((n = read(fd, req + have, sizeof(req) - 1 - have)) > 0) {
+      have += n;
+      req[have] = '\0';
+      while((nl = strchr(req, '\n'))) {
+         *nl = '\0';
+         if(nl > req && nl[-1] == '\r') nl[-1] = '\0';
+         lines = timed_answer(req, e, out, MAXANSWER);
+         if(lines < 0) snprintf(head, sizeof(head), "ERR ");
+         else snprintf(head, sizeof(head), "OK %d\n", lines);
+         if(write_all(fd, head, strlen(head)) != 0 || write_all(fd, out, strlen(out)) != 0 ||
+            (lines < 0 && write_all(fd, "\n", 1) != 0)) {
+            have = 0;
+            break;
+         }
+         have -= nl + 1 - req;
+         memmove(req, nl + 1, have + 1);
+      }
+      if(have == sizeof(req) - 1) break;       // line too long
+   }
+}
+
+/* ------------------------------------------------------------ *
+ * http_param() copies the value of query parameter name        *
+ * ------------------------------------------------------------ */
+static void http_param(const char *query, const char *name, char *value, size_t size) {
+   size_t len = strlen(name), n;
+   const char *p = query;
+
+   value[0] = '\0';
+   while(p && *p) {
+      if(strncmp(p, name, len) == 0 && p[len] == '=') {
+         p += len + 1;
+         n = strcspn(p, "& ");
+         if(n >= size) n = size - 1;
+         memcpy(value, p, n);
+         value[n] = '\0';
+         return;
+      }
+      p = strchr(p, '&');
+      if(p) p++;
+   }
+}
+
+/* ------------------------------------------------------------ *
+ * http_client() answers one HTTP GET request                   *
+ * ------------------------------------------------------------ */
+static void http_client(int fd, struct dayentry *e, char *out) {
+   char buf[MAXREQUEST], req[MAXREQUEST], path[16] = "", *target, *query;
+   char x[32], y[32], t[32], at[32], date[32], i[16], head[128];
+   size_t have = 0;
+   ssize_t n;
+   int lines;
+
+   while(have < sizeof(buf) - 1 && (n = read(fd, buf + have, sizeof(buf) - 1 - have)) > 0) {
+      have += n;
+      buf[have] = '\0';
+      if(strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n")) break;
+   }
+   buf[have] = '\0';
+   if(strncmp(buf, "GET /", 5) == 0 && sscanf(buf + 5, "%15[a-z]", path) == 1) {
+      target = buf + 4;
+      target[strcspn(target, " \r\n")] = '\0';
+      if((query = strchr(target, '?'))) query++;
+      http_param(query, "x", x, sizeof(x));
+      http_param(query, "y", y, sizeof(y));
+      http_param(query, "t", t, sizeof(t));
+      http_param(query, "at", at, sizeof(at));
+      http_param(query, "date", date, sizeof(date));
+      http_param(query, "i", i, sizeof(i));
+      snprintf(req, sizeof(req), "%s %s %s %s %s %s", path, x, y, t, strcmp(path, "pos") == 0 ? at : date, i);
+      lines = timed_answer(req, e, out, MAXANSWER);
+      snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n\r\n",
+               lines < 0 ? "400 Bad Request" : "200 OK", strlen(out));
+      if(write_all(fd, head, strlen(head)) == 0) write_all(fd, out, strlen(out));
+   }
+   else {
+      snprintf(head, sizeof(head), "HTTP/1.0 400 Bad Request\r\nContent-Length: 0\r\n\r\n");
+      write_all(fd, head, strlen(head));
+   }
+}
+
+/* ------------------------------------------------------------ *
+ * client threads, one per connection                           *
+ * ------------------------------------------------------------ */
+struct client {
+   int fd;
+   int http;
+};
+
+static void *client_thread(void *arg) {
+   struct client c = *(struct client *) arg;
+   struct dayentry *e = malloc(sizeof(struct dayentry));
+   char *out = malloc(MAXANSWER);
+
+   free(arg);
+   if(e && out && c.http) http_client(c.fd, e, out);
+   else if(e && out) unix_client(c.fd, e, out);
+   close(c.fd);
+   free(e);
+   free(out);
+   return NULL;
+}
+
+static void on_signal(int sig) {
+   stop = 1;
+}
+
+/* ------------------------------------------------------------ *
+ * serve_run() opens the listeners and starts a thread for each *
+ * client connection                                            *
+ * ------------------------------------------------------------ */
+int serve_run(const char *listen_on, int httpport, int size, int verbose) {
+   struct sockaddr_un ua = { .sun_family = AF_UNIX };
+   struct sockaddr_in ia = { .sin_family = AF_INET };
+   struct pollfd pfd[2];
+   struct sigaction sa;
+   struct stat st;
+   pthread_attr_t attr;
+   pthread_t tid;
+   char out[256];
+   int nfd = 1, i, one = 1;
+
+   debug = verbose;
+   if(strncmp(listen_on, "unix:", 5) != 0 || strlen(listen_on + 5) == 0 ||
+      strlen(listen_on + 5) >= sizeof(ua.sun_path)) {
+      printf("Error: --serve needs a socket as unix:/path, got %s\n", listen_on);
+      return -1;
+   }
+   cachesize = size;
+   if(! (cache = calloc(cachesize, sizeof(struct dayentry)))) {
+      printf("Error: cannot allocate the cache of %d day tables\n", cachesize);
+      return -1;
+   }
+
+   /* -------------------------------------------------------- *
+    * unix socket, a socket file left by an earlier run is     *
+    * removed                                                  *
+    * -------------------------------------------------------- */
+   strcpy(ua.sun_path, listen_on + 5);
+   if(stat(ua.sun_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(ua.sun_path);
+   pfd[0].fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   pfd[0].events = POLLIN;
+   if(pfd[0].fd < 0 || bind(pfd[0].fd, (struct sockaddr *) &ua, sizeof(ua)) != 0 || listen(pfd[0].fd, 64) != 0) {
+      printf("Error: cannot listen on %s: %s\n", ua.sun_path, strerror(errno));
+      return -1;
+   }
+   printf("Listen on unix socket [%s]\n", ua.sun_path);
+
+   /* -------------------------------------------------------- *
+    * HTTP listener on the loopback interface only             *
+    * -------------------------------------------------------- */
+   if(httpport > 0) {
+      ia.sin_port = htons(httpport);
+      ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      pfd[1].fd = socket(AF_INET, SOCK_STREAM, 0);
+      pfd[1].events = POLLIN;
+      if(pfd[1].fd >= 0) setsockopt(pfd[1].fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      if(pfd[1].fd < 0 || bind(pfd[1].fd, (struct sockaddr *) &ia, sizeof(ia)) != 0 || listen(pfd[1].fd, 64) != 0) {
+         printf("Error: cannot listen on 127.0.0.1:%d: %s\n", httpport, strerror(errno));
+         unlink(ua.sun_path);
+         return -1;
+      }
+      printf("Listen on http://127.0.0.1:%d/\n", httpport);
+      nfd = 2;
+   }
+   fflush(stdout);
+
+   /* -------------------------------------------------------- *
+    * SIGINT and SIGTERM interrupt poll() to end the service   *
+    * -------------------------------------------------------- */
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = on_signal;
+   sigaction(SIGINT, &sa, NULL);
+   sigaction(SIGTERM, &sa, NULL);
+   signal(SIGPIPE, SIG_IGN);
+   pthread_attr_init(&attr);
+   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+   while(! stop) {
+      if(poll(pfd, nfd, -1) < 0) continue;
+      for(i = 0; i < nfd; i++) {
+         if(! (pfd[i].revents & POLLIN)) continue;
+         struct client *c = malloc(sizeof(struct client));
+         if(! c) continue;
+         c->http = i;
+         if((c->fd = accept(pfd[i].fd, NULL, NULL)) < 0 || pthread_create(&tid, &attr, client_thread, c) != 0) {
+            if(c->fd >= 0) close(c->fd);
+            free(c);
+         }
+      }
+   }
+
+   for(i = 0; i < nfd; i++) close(pfd[i].fd);
+   unlink(ua.sun_path);
+   stats_lines(out, sizeof(out));
+   printf("Service stopped, requests and cache (used, size, hits, misses), latency p50 p99 in us:\n%s", out);
+   return 0;
+}
@@ -0,0 +1,24 @@
+/* ------------------------------------------------------------ *
+ * file:        serve.h                                         *
+ * purpose:     position service for suncalc --serve, answers   *
+ *              position, day table and srs queries from a      *
+ *              cache of calculated days.                       *
+ * ------------------------------------------------------------ */
+#ifndef SERVE_H
+#define SERVE_H
+
+/* ------------------------------------------------------------ *
+ * default number of cached day tables, about 40KB each         *
+ * ------------------------------------------------------------ */
+#define SERVE_CACHE 256
+
+/* ------------------------------------------------------------ *
+ * serve_run() listens on the unix socket of listen, given as   *
+ * "unix:/path", and with httpport > 0 also for HTTP on         *
+ * 127.0.0.1:httpport. It runs until SIGINT or SIGTERM, then    *
+ * prints the request statistics. Returns 0, or -1 if a socket  *
+ * cannot be opened.                                            *
+ * ------------------------------------------------------------ */
+int serve_run(const char *listen, int httpport, int cachesize, int verbose);
+
+#endif
@@ -0,0 +1,179 @@
+/* ------------------------------------------------------------ *
+ * file:        sunarc.c                                        *
+ * purpose:     list, test and extract the compressed day       *
+ *              record archive written by suncalc -g            *
+ *                                                              *
+ * return:      0 on success, and -1 on errors.                 *
+ *                                                              *
+ * example:	./sunarc -l ./tracker-data/archive.gor       *
+ *                                                              *
+ * Extracted day files yyyymmdd.bin are byte identical to the   *
+ * fixed layout day files suncalc writes without -a, -n or -b.  *
+ * ------------------------------------------------------------ */
+#include <stdlib.h>    // various, atoi
+#include <stdio.h>     // run display
+#include <stdint.h>    // uint8_t data type
+#include <string.h>    // string handling
+#include <unistd.h>    // getopt
+#include <getopt.h>    // arg handling
+#include <time.h>      // decode timing
+#include "sunread.h"   // day record size
+#include "gorilla.h"   // compressed archive functions
+
+/* ------------------------------------------------------------ *
+ * global variables and defaults                                *
+ * ------------------------------------------------------------ */
+int verbose = 0;
+char progver[] = "1.2";              // sunarc program version, same as suncalc
+int list = 0;                        // -l list the day blocks
+int test = 0;                        // -t decode all blocks, show the speed
+char outdir[256] = "";               // -x extract day files into this folder
+uint32_t startdate = 0;              // -s first day to process, yyyymmdd
+uint32_t enddate = 99999999;         // -e last day to process, yyyymmdd
+
+/* ------------------------------------------------------------ *
+ * print_usage() prints the programs commandline instructions.  *
+ * ------------------------------------------------------------ */
+void usage() {
+   static char const usage[] = "Usage: ./sunarc [-l] [-t] [-x outfolder] [-s yyyymmdd] [-e yyyymmdd] [-v] archive.gor\n\
+\n\
+Command line parameters have the following format:\n\
+   -l   list the day blocks: date, records and compressed size\n\
+   -t   decode all day blocks, and show the decode speed\n\
+   -x   extract the day records as yyyymmdd.bin files into outfolder\n\
+   -s   first day to list, test or extract, Example: -s 20190701\n\
+   -e   last day to list, test or extract, Example: -e 20190731\n\
+   -h   display this message\n\
+   -v   enable debug output\n\
+\n\
+Usage examples:\n\
+./sunarc -l ./tracker-data/archive.gor\n\
+./sunarc -x ./restore -s 20190701 -e 20190731 ./tracker-data/archive.gor\n";
+   printf("sunarc v%s\n\n", progver);
+   printf(usage);
+}
+
+/* ----------------------------------------------------------- *
+ * parseargs() checks the commandline arguments with C getopt  *
+ * ----------------------------------------------------------- */
+void parseargs(int argc, char* argv[]) {
+   int arg;
+   opterr = 0;
+
+   while ((arg = (int) getopt (argc, argv, "ltx:s:e:hv")) != -1) {
+      switch (arg) {
+         // arg -v verbose, type: flag, optional
+         case 'v':
+            verbose = 1; break;
+
+         // arg -l list day blocks, type: flag
+         case 'l':
+            list = 1; break;
+
+         // arg -t test decode, type: flag
+         case 't':
+            test = 1; break;
+
+         // arg -x extract folder
+         case 'x':
+            snprintf(outdir, sizeof(outdir), "%s", optarg);
+            break;
+
+         // arg -s -e date range type: yyyymmdd
+         case 's':
+         case 'e':
+            if(strlen(optarg) != 8 || atoi(optarg) < 19000101) {
+               printf("Error: Cannot get valid date %s.\n", optarg);
+               exit(-1);
+            }
+            if(arg == 's') startdate = atoi(optarg);
+            else enddate = atoi(optarg);
+            break;
+
+         // arg -h usage, type: flag, optional
+         case 'h':
+            usage(); exit(0);
+            break;
+
+         default:
+            usage();
+            exit(-1);
+      }
+   }
+   if(optind != argc - 1) {
+      printf("Error: no archive file given.\n");
+      usage();
+      exit(-1);
+   }
+   if(list + test + (strlen(outdir) > 0) == 0) list = 1;
+}
+
+/* ------------------------------------------------------------ *
+ * main() function to execute the program                       *
+ * ------------------------------------------------------------ */
+int main(int argc, char *argv[]) {
+   static uint8_t data[gor_maxbytes(GOR_MAXROWS)];
+   static uint8_t rec[GOR_MAXROWS * DAYREC_SIZE];
+   struct gorindex *index;
+   struct gorblock block;
+   FILE *farc, *fday;
+   char fpath[1024];
+   long rows = 0, bytes = 0;
+   int days, done = 0, i;
+   clock_t start;
+
+   parseargs(argc, argv);
+   if(! (farc = fopen(argv[optind], "r"))) {
+      printf("Error open %s for reading\n", argv[optind]);
+      exit(-1);
+   }
+   if((days = gor_read_index(farc, &index)) < 0) {
+      printf("Error: %s is no valid archive file\n", argv[optind]);
+      exit(-1);
+   }
+   if(verbose == 1) printf("Debug: archive [%s] days [%d]\n", argv[optind], days);
+
+   start = clock();
+   for(i = 0; i < days; i++) {
+      if(index[i].date < startdate || index[i].date > enddate) continue;
+      /* -------------------------------------------------------- *
+       * the blocks follow each other, so a sequential scan only  *
+       * seeks once, to the first day of the range               *
+       * -------------------------------------------------------- */
+      if(fseek(farc, index[i].offset, SEEK_SET) != 0 ||
+         fread(&block, sizeof(block), 1, farc) != 1 ||
+         block.date != index[i].date || block.rows > GOR_MAXROWS ||
+         block.bytes > sizeof(data) || fread(data, 1, block.bytes, farc) != block.bytes) {
+         printf("Error reading block %d of %s\n", i, argv[optind]);
+         exit(-1);
+      }
+      if(list) printf("%u records [%4u] bytes [%5u] (%.2f per record)\n", block.date,
+                      block.rows, block.bytes, block.rows ? (double) block.bytes / block.rows : 0);
+      if(test || strlen(outdir) > 0) {
+         if(gor_decode(data, block.bytes, block.rows, rec) != 0) {
+            printf("Error decoding block %u of %s\n", block.date, argv[optind]);
+            exit(-1);
+         }
+      }
+      if(strlen(outdir) > 0) {
+         snprintf(fpath, sizeof(fpath), "%s/%u.bin", outdir, block.date);
+         if(! (fday = fopen(fpath, "w"))) {
+            printf("Error open %s for writing\n", fpath);
+            exit(-1);
+         }
+         else if(verbose == 1) printf("Debug: extract day file [%s]\n", fpath);
+         fwrite(rec, DAYREC_SIZE, block.rows, fday);
+         fclose(fday);
+      }
+      rows += block.rows;
+      bytes += sizeof(block) + block.bytes;
+      done++;
+   }
+   printf("Archive: %d days, %ld records, %ld record bytes in %ld bytes (%.1f:1)\n",
+          done, rows, rows * DAYREC_SIZE, bytes, bytes ? (double) rows * DAYREC_SIZE / bytes : 0);
+   if(test)
+      printf("Decoded %ld records in %.3f seconds\n", rows, (double) (clock() - start) / CLOCKS_PER_SEC);
+   free(index);
+   fclose(farc);
+   return 0;
+}
@@ -11,7 +11,8 @@
  *                                                              *
  * author:      05/24/2019 Frank4DD                             *
  *                                                              *
- * This program calculates the sun position for given coords.   *
+ * This program calculates the sun position for given coords,   *
+ * using the generator in libsuncalc.c.                         *
  * The results are written into a ./data-tracker folder:        *
  * dset.txt -> dataset information file                         *
  * yyyymmdd.csv -> sun position daily file in readable csv      *
@@ -25,6 +26,7 @@
  * Remember the program version needs to match the MCU code for *
  * successful extract of the file structures by the MCU program *
  * ------------------------------------------------------------ */
+#define _GNU_SOURCE              // syncfs, renameat2
 #include <stdlib.h>    // various, atoi, atof
 #include <stdio.h>     // run display
 #include <ctype.h>     // isprint
@@ -37,19 +39,28 @@
 #include <getopt.h>    // arg handling
 #include <time.h>      // time and date
 #include <math.h>      // round()
+#include <errno.h>     // stream write errors
+#include <poll.h>      // stream backpressure
+#include <signal.h>    // stream SIGPIPE
+#include <fcntl.h>     // srs slot file open
+#include <sys/wait.h>  // waitpid
 #include "spa.h"       // SPA functions
+#include "libsuncalc.h" // dataset generator
+#include "sunread.h"   // data file reader functions
+#include "gorilla.h"   // compressed archive functions
+#include "serve.h"     // position service for --serve
+#include "filter.h"    // timestamp filter for --filter
+#include "pipeline.h"  // generator and file output as pipeline stages
+#include "awrite.h"    // day file writer backends for -w
+#include "daycache.h"  // day file cache for --cachedir
+#include "serial.h"    // position stream for --stream
+#ifdef HAVE_SQLITE
+#include <sqlite3.h>   // SQLite sink, build with make SQLITE=1
+#endif
 
 /* ------------------------------------------------------------ *
  * global variables and defaults                                *
  * ------------------------------------------------------------ */
-#define DELTA_UT1	0
-#define DELTA_T		67
-#define ELEVATION	1000
-#define PRESSURE	1000
-#define TEMPERATURE	19
-#define SLOPE		0
-#define AZM_ROTATION	0
-#define ATM_REFRACT	0.5667
 
 /* ------------------------------------------------------------ *
  * Tokyo Magnetic Declination: -7° 35'                         *
@@ -63,10 +74,10 @@ int verbose = 0;
 char progver[] = "1.2";              // suncalc program version
 char period[3] = "nd";               // default calculation period
 char rundate[20] = "";               // program run date
-char outdir[256] = "./tracker-data"; // default output folder
+char outdir[256] = "./tracker-data"; // default output folder, the staging folder while writing
+char pubdir[256] = "";               // published output folder, outdir is staged beside it
 char dsetfile[] = "dset.txt";        // dataset parameter information file
-char daycfile[20] = "";              // daily csv dataset file <yyyymmdd.csv>
-char daybfile[20] = "";              // daily bin dataset file <yyyymmdd.bin>
+char ckptfile[] = "checkpoint.txt";  // resume point of an unfinished dataset
 char srsbfile[20] = "";              // yearly sunrise/sunset bin file <srs-yyyy.bin>
 char srscfile[20] = "";              // yearly sunrise/sunset csv file <srs-yyyy.csv>
 double longitude = 139.628999;       // long default if not set by cmdline
@@ -74,6 +85,50 @@ double latitude = 35.610381;         // lat default if not set by cmdline
 double mdeclination = -7.583;        // mag declination default for lat/long above
 double tz = +9;                      // timezone default if not set by cmdline
 int interval = 60;                   // interval default if not set by cmdline
+double tolerance = 0.0;              // adaptive sampling tolerance in degrees, 0 = off
+double maxerror = 0.0;               // adaptive sampling max error found in the dataset
+long allrows = 0;                    // adaptive sampling total of calculated records
+long keptrows = 0;                   // adaptive sampling total of written records
+int chebyshev = 0;                   // write Chebyshev coefficient day files
+double chebmaxerr = 0.0;             // Chebyshev max error found in the dataset
+int daylight = 0;                    // write daylight records only, with day header
+int srsslots = 0;                    // write srs files with 366 day-of-year slots
+int dirtree = 0;                     // write day files into yyyy/mm subfolders
+int blockalign = 0;                  // day file block size for aligned records, 0 = packed
+int columns = 0;                     // write column day files .az .ze .df with -l
+char format[8] = "";                 // additional output format, e.g. npy
+long npyrows = 0;                    // row count written to the npy column files
+int archive = 0;                     // write the compressed archive.gor with -g
+struct garchive garch;               // the archive file while it is written
+long archraw = 0;                    // day record bytes that went into the archive
+long archbytes = 0;                  // compressed bytes written to the archive
+long flashlimit = 196608;            // -f progmem data budget, MKR Zero 256K flash - 64K program
+int residual = 0;                    // write later years as residual day files with -r
+int refyear = 0;                     // reference year of the residual day files
+long resdays = 0;                    // residual day files written
+long resbytes = 0;                   // residual day file bytes written
+char serveon[256] = "";              // --serve unix:/path position service, "" = off
+int httpport = 0;                    // --http loopback port of the service, 0 = off
+int cachedays = SERVE_CACHE;         // --cache day tables kept by the service
+char attime[20] = "";                // --at yyyy-mm-ddThh:mm:ss point query, "" = off
+char filtermode[4] = "";             // --filter text|bin stdin timestamps, "" = off
+char streamdev[256] = "";            // --stream serial device or pty, "" = off
+int writer = AWRITE_STDIO;           // day file writer backend, -w
+char daycachedir[256] = "";          // --cachedir day file cache folder, "" = off
+int daycacheon = 0;                  // the day file cache is used in this run
+long cachehits = 0;                  // days linked from the cache
+long cachemisses = 0;                // days calculated and added to the cache
+#define CKPTSECS 10                  // seconds between checkpoints
+int resume = 0;                      // --resume continues from the checkpoint
+int checkpoints = 0;                 // write checkpoints in this run
+time_t lastckpt = 0;                 // time the last checkpoint was written
+time_t periodstart = 0;              // dataset period, for the checkpoint
+time_t periodend = 0;
+char runparams[1280] = "";           // options that make the dataset, for the checkpoint
+char dbfile[256] = "";               // SQLite database file for -q, "" = off
+int streamfd = -1;                   // stdout data stream for '-o -', -1 = off
+char streambuf[65536];               // stdout data stream write buffer
+size_t streamlen = 0;                // bytes waiting in the stream buffer
 
 /* ------------------------------------------------------------ *
  * brecord structure contains the sun angles per time interval  *
@@ -88,30 +143,58 @@ struct brecord {
 };
 
 /* ------------------------------------------------------------ *
- * drecord structure contains the daily sun min/max values      *
- * and is stored in the yearly srs file. record size: 14 bytes  *
- * transit elevation fits into int8_t, I use int16_t to avoid   *
- * compiler padding to memory-align the structure.              *
+ * flashdata collects the whole period for '-f progmem', which  *
+ * writes it as one C header at the end of the run. Day data is *
+ * the Chebyshev days with '-c', or else the daylight positions *
+ * in 1/100 degree, with a daylight header per day.             *
  * ------------------------------------------------------------ */
-struct drecord {
-   uint8_t month;                    // 1-12 month of the year
-   uint8_t day;                      // 1-31 day of the year
-   uint8_t risehour;                 // 0-23 sunrise hour
-   uint8_t riseminute;               // 0-59 sunrise minute
-   uint16_t riseazimuth;             // 0-359 (round to full degree to reduce datatype storage)
-   uint8_t transithour;              // 0-23 zenith peak hour
-   uint8_t transitminute;            // 0-59 zenit peak minute
-   int16_t transitelevation;         // -90..90 (max sun height, rounded to full degree)
-   uint8_t sethour;                  // 0-23 sunset hour
-   uint8_t setminute;                // 0-59 sunset minute
-   uint16_t setazimuth;              // 0-359 (see above)
+struct flashdata {
+   int days;                         // number of days collected
+   int srsdays;                      // number of srs records collected
+   struct drecord *srs;              // srs record per day
+   struct chebday *cheb;             // Chebyshev day per day, with -c
+   struct dayhead *head;             // daylight header per day
+   uint32_t *start;                  // index of the first position per day
+   uint16_t (*pos)[2];               // azimuth and zenith in 1/100 degree
+   long npos;                        // number of positions
+} flash;
+
+/* ------------------------------------------------------------ *
+ * refdays keeps the reference year angles for '-r', indexed   *
+ * by the date slot: the day of a leap year, Feb-29 is slot 59. *
+ * ------------------------------------------------------------ */
+struct refday {
+   int rows;                         // number of rows, 0 = date not in reference year
+   double azimuth[MAXROWS];          // azimuth angle
+   double zenith[MAXROWS];           // zenith angle
+} refdays[366];
+
+/* ------------------------------------------------------------ *
+ * npy column files for '-f npy', one file per dayset column.   *
+ * The descr strings are the NumPy little-endian type codes.    *
+ * ------------------------------------------------------------ */
+#define NPYCOLS 4
+#define NPYHEAD 128
+struct npycol {
+   const char *name;                 // column and file name
+   const char *descr;                // NumPy data type
+   FILE *file;                       // open .npy file
+} npycols[NPYCOLS] = {
+   { "time",    "<i8", NULL },
+   { "azimuth", "<f8", NULL },
+   { "zenith",  "<f8", NULL },
+   { "dflag",   "|u1", NULL }
 };
 
 /* ------------------------------------------------------------ *
  * print_usage() prints the programs commandline instructions.  *
  * ------------------------------------------------------------ */
 void usage() {
-   static char const usage[] = "Usage: ./suncalc [-x <longitude>] [-y <latitude>] [-t <timezone>] [-i <interval>] [-p period nd|nm|nq|ny|td|tm|tq|ty] [-o outfolder] [-v]\n\
+   static char const usage[] = "Usage: ./suncalc [-x <longitude>] [-y <latitude>] [-t <timezone>] [-i <interval>] [-p period nd|nm|nq|ny|td|tm|tq|ty] [-a tolerance] [-c] [-n] [-l] [-s] [-d] [-b] [-g] [-r] [-q dbfile] [-f npy|progmem|bin|csv|json] [-m flashlimit] [-w stdio|threads|uring] [--cachedir folder] [--resume] [-o outfolder|-] [-v]\n\
+       ./suncalc --serve unix:/path [--http port] [--cache days] [-v]\n\
+       ./suncalc --at yyyy-mm-ddThh:mm:ss|now [-x <longitude>] [-y <latitude>] [-t <timezone>]\n\
+       ./suncalc --filter text|bin [-x <longitude>] [-y <latitude>] [-t <timezone>] [-i <interval>]\n\
+       ./suncalc --stream /dev/ttyACM0 [-x <longitude>] [-y <latitude>] [-t <timezone>] [-i <interval>] [-v]\n\
 \n\
 Command line parameters have the following format:\n\
    -x   location longitude, Example: -x 139.628999 (default)\n\
@@ -130,9 +213,59 @@ Command line parameters have the following format:\n\
            ty = this year (starting Jan-1 until Dec-31, 23M)\n\
            2y = two years (starting this year, 46M)\n\
            tf = ten years forward (starting this year, 230M)\n\
+   -a   adaptive sampling, only write a day record if azimuth or zenith changed\n\
+        by more than the tolerance in degrees (0.01 to 10), Example: -a 0.5\n\
+   -c   write Chebyshev coefficient day files yyyymmdd.chb (112 bytes per day)\n\
+        instead of the day bin and csv files\n\
+   -n   write daylight records only, the day bin file starts with a 6 byte header\n\
+        holding the first record time, record count and interval\n\
+   -l   write column day files instead of the day bin file: yyyymmdd.az and\n\
+        yyyymmdd.ze with the angle as 8 byte double, yyyymmdd.df with the day flag\n\
+   -s   write srs-yyyy.bin with 366 fixed slots, one per day of the year,\n\
+        slots of days not calculated are zero\n\
+   -d   write day files into year and month subfolders yyyy/mm/dd.bin\n\
+   -b   align day bin records to 512 byte SD card sectors, no record crosses\n\
+        a sector boundary (26 records per sector, padded with zeros)\n\
+   -g   additionally write archive.gor, all day records of the period compressed\n\
+        with a block per day, extract them with sunarc\n\
+   -r   with -p 2y or tf, write the years after the first as residual day files\n\
+        yyyymmdd.rsd, the 1/100 degree difference to the same date of the 1st year\n\
+   -q   additionally write all calculated rows and srs records into the SQLite\n\
+        database dbfile, runs for other sites add to it, Example: -q fleet.db\n\
+   -f   additional output format:\n\
+           npy = NumPy column files time.npy, azimuth.npy, zenith.npy, dflag.npy\n\
+                 with all calculated rows of the period, e.g. for pandas\n\
+           progmem = C header sundata.h with the dataset as const PROGMEM arrays,\n\
+                 for trackers without SD card: the srs records, and the daylight\n\
+                 positions in 1/100 degree, or the Chebyshev days with -c\n\
+           bin, csv, json = day record format for streaming to stdout with -o -\n\
+                 bin is the 19 byte record (default), csv and json lines add the date\n\
+   -m   flash budget in bytes for -f progmem, Example: -m 196608 (default)\n\
+   -w   day file writer: stdio = fopen/fclose per file (default), threads = pool of\n\
+        writer threads, uring = batched io_uring openat/write/close, falls back to\n\
+        threads if the kernel cannot. Example: -w uring\n\
    -o   output folder, Example: -o ./tracker-data (default)\n\
+        -o - streams the day records to stdout instead, without writing any files\n\
    -h   display this message\n\
    -v   enable debug output\n\
+   --serve  run as position service on the unix socket, answers pos, day and srs\n\
+            requests from a cache of day tables, Example: --serve unix:/run/suncalc.sock\n\
+   --http   also answer HTTP GET requests on 127.0.0.1, Example: --http 8080\n\
+   --cache  number of day tables the service keeps, Example: --cache 256 (default)\n\
+   --at     print the sun position at the local time as one csv line: time, day flag,\n\
+            azimuth, zenith, elevation. No files are read or written, Example:\n\
+            --at 2026-10-16T14:05:00\n\
+   --filter read timestamps from stdin, text: one per line as unix seconds or ISO-8601,\n\
+            bin: packed int64 unix seconds. Writes time,dflag,azimuth,zenith csv lines\n\
+            to stdout, interpolated from day tables of the -i interval\n\
+   --stream send the position record of each -i interval to a tracker on a serial\n\
+            device or pty, framed with a CRC, on the interval boundary of the clock,\n\
+            until stopped with Ctrl-C, Example: --stream /dev/ttyACM0\n\
+   --cachedir keep the day files in a cache folder under a hash of their inputs,\n\
+            and link them from there in later runs with the same site, timezone,\n\
+            interval and layout instead of calculating them, Example: --cachedir ./cache\n\
+   --resume continue the unfinished dataset in the output folder from its last\n\
+            checkpoint, instead of deleting it and starting over\n\
 \n\
 Usage examples:\n\
 ./suncalc -x 139.628999 -y 35.610381 -t +9 -i 600 -p nd -o ./tracker-data -v\n\n\
@@ -176,142 +309,1616 @@ void debug_spa_input(spa_data spa) {
    printf("spa.atmos_refract: %f\n", spa.atmos_refract);
 }
 
-/* ------------------------------------------------------------ *
- * remove_data() delete old dataset if same folder gets reused  *
- * ------------------------------------------------------------ */
-void remove_data(const char *path) {
-   DIR *d = opendir(path);
-   size_t path_len = strlen(path);
-   int r = -1;
-
-   if(d) {
-      struct dirent *p;
-      r = 0;
-
-      while (!r && (p=readdir(d))) {
-          int r2 = -1;
-          char *buf;
-          size_t len;
-
-          /* ------------------------------------------------------------ *
-           * Skip "." and ".." folders                                    * 
-           * ------------------------------------------------------------ */
-          if (!strcmp(p->d_name, ".") || !strcmp(p->d_name, "..")) {
-             continue;
-          }
-
-          len = path_len + strlen(p->d_name) + 2; 
-          buf = malloc(len);
-
-          if (buf) {
-             struct stat statbuf;
-             snprintf(buf, len, "%s/%s", path, p->d_name);
-             if (!stat(buf, &statbuf)) {
-                if(verbose == 1) printf("Debug: delete old dataset file %s\n", buf);
-                r2 = unlink(buf);
-             }
-             free(buf);
-          }
-          r = r2;
-      }
-      closedir(d);
+/* ------------------------------------------------------------ *
+ * layout_folder() returns 1 if name is a '-d' layout folder of *
+ * the given number of digits, yyyy for a year or mm for month *
+ * ------------------------------------------------------------ */
+int layout_folder(const char *name, size_t digits) {
+   size_t i;
+
+   if(strlen(name) != digits) return 0;
+   for(i = 0; i < digits; i++) if(!isdigit((unsigned char) name[i])) return 0;
+   return 1;
+}
+
+/* ------------------------------------------------------------ *
+ * remove_tree() deletes the files of the open folder dirfd. At *
+ * depth 0, the dataset folder, the yyyy year folders of the   *
+ * '-d' layout are entered, at depth 1 the mm month folders.   *
+ * Other folders are kept, see keep_tree(). All calls are     *
+ * relative to the folder and the entry type comes from        *
+ * readdir(), so there is no path building and no stat() per   *
+ * file. Symlinks are removed, never followed. The folder is   *
+ * closed.                                                      *
+ * ------------------------------------------------------------ */
+void remove_tree(int dirfd, int depth) {
+   DIR *d = fdopendir(dirfd);
+   struct dirent *p;
+   struct stat st;
+   int sub, isdir;
+
+   if(!d) {
+      close(dirfd);
+      return;
+   }
+   while((p = readdir(d))) {
+      /* ------------------------------------------------------------ *
+       * Skip "." and ".." folders                                    *
+       * ------------------------------------------------------------ */
+      if (!strcmp(p->d_name, ".") || !strcmp(p->d_name, "..")) continue;
+      isdir = p->d_type == DT_DIR;
+      if(p->d_type == DT_UNKNOWN)
+         isdir = fstatat(dirfd, p->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+      if(isdir) {
+         if(!(depth == 0 && layout_folder(p->d_name, 4)) && !(depth == 1 && layout_folder(p->d_name, 2))) continue;
+         if((sub = openat(dirfd, p->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW)) >= 0) remove_tree(sub, depth + 1);
+         if(verbose == 1) printf("Debug: delete old dataset folder %s\n", p->d_name);
+         unlinkat(dirfd, p->d_name, AT_REMOVEDIR);
+      }
+      else {
+         if(verbose == 1) printf("Debug: delete old dataset file %s\n", p->d_name);
+         unlinkat(dirfd, p->d_name, 0);
+      }
+   }
+   closedir(d);
+}
+
+/* ------------------------------------------------------------ *
+ * remove_data() deletes the dataset in folder path, and the    *
+ * folder if nothing else is left in it                         *
+ * ------------------------------------------------------------ */
+void remove_data(const char *path) {
+   int dirfd = open(path, O_RDONLY | O_DIRECTORY);
+
+   if(dirfd >= 0) remove_tree(dirfd, 0);
+   rmdir(path);
+}
+
+/* ------------------------------------------------------------ *
+ * discard_data() renames the folder path out of the way, to   *
+ * path.old-pid-n, and deletes it in a child process, so the   *
+ * run does not wait for it. The name is free again at once.   *
+ * ------------------------------------------------------------ */
+void discard_data(const char *path) {
+   static int discards = 0;
+   char oldpath[300];
+   pid_t pid;
+
+   snprintf(oldpath, sizeof(oldpath), "%s.old-%d-%d", pubdir, (int) getpid(), ++discards);
+   if(rename(path, oldpath) != 0) {
+      printf("Error move %s out of the way to %s\n", path, oldpath);
+      exit(-1);
+   }
+   if(verbose == 1) printf("Debug: delete old folder [%s] in the background\n", oldpath);
+   fflush(stdout);
+   if((pid = fork()) == 0) {
+      verbose = 0;
+      if(fork() > 0) _exit(0);
+      remove_data(oldpath);
+      _exit(0);
+   }
+   if(pid > 0) waitpid(pid, NULL, 0);
+   else remove_data(oldpath);
+}
+
+/* ------------------------------------------------------------ *
+ * keep_tree() moves the folders remove_tree() keeps from the   *
+ * dataset folder fromfd to the same place in the new dataset  *
+ * folder tofd, so they carry over and the old dataset can be  *
+ * deleted completely. A yyyy or mm folder is created in tofd   *
+ * only if something moves into it. Both folders are closed.    *
+ * ------------------------------------------------------------ */
+void keep_tree(int fromfd, int tofd, int depth) {
+   DIR *d = fdopendir(fromfd);
+   struct dirent *p;
+   struct stat st;
+   int from, to, isdir, made;
+
+   if(!d) {
+      close(fromfd);
+      close(tofd);
+      return;
+   }
+   while((p = readdir(d))) {
+      if (!strcmp(p->d_name, ".") || !strcmp(p->d_name, "..")) continue;
+      isdir = p->d_type == DT_DIR;
+      if(p->d_type == DT_UNKNOWN)
+         isdir = fstatat(fromfd, p->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+      if(!isdir) continue;
+      if(!(depth == 0 && layout_folder(p->d_name, 4)) && !(depth == 1 && layout_folder(p->d_name, 2))) {
+         if(verbose == 1) printf("Debug: keep folder %s in the new dataset\n", p->d_name);
+         if(renameat(fromfd, p->d_name, tofd, p->d_name) != 0)
+            printf("Warning: folder %s not moved to the new dataset, it stays in the old one\n", p->d_name);
+         continue;
+      }
+      made = mkdirat(tofd, p->d_name, 0700) == 0;
+      if((from = openat(fromfd, p->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW)) >= 0) {
+         if((to = openat(tofd, p->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW)) >= 0) keep_tree(from, to, depth + 1);
+         else close(from);
+      }
+      if(made) unlinkat(tofd, p->d_name, AT_REMOVEDIR);
+   }
+   closedir(d);
+   close(tofd);
+}
+
+/* ------------------------------------------------------------ *
+ * check_pubdir() strips trailing slashes from pubdir, so the   *
+ * staging folder is created beside it and not inside it. Then *
+ * it stops the run before any work if publish_data() could not *
+ * rename pubdir: '.', '..' or '/', a file, a mount point, or  *
+ * not on the file system of its parent folder.                 *
+ * ------------------------------------------------------------ */
+void check_pubdir() {
+   char parent[256], *base;
+   struct statx stx;
+   struct stat st, pst;
+   size_t len = strlen(pubdir);
+
+   while(len > 1 && pubdir[len - 1] == '/') pubdir[--len] = '\0';
+   base = strrchr(pubdir, '/');
+   base = base ? base + 1 : pubdir;
+   if(strcmp(base, ".") == 0 || strcmp(base, "..") == 0 || strcmp(pubdir, "/") == 0) {
+      printf("Error: output folder %s cannot be replaced by rename, use a named folder.\n", pubdir);
+      exit(-1);
+   }
+   if(stat(pubdir, &st) != 0) return;
+   if(!S_ISDIR(st.st_mode)) {
+      printf("Error: output folder %s is not a folder.\n", pubdir);
+      exit(-1);
+   }
+   snprintf(parent, sizeof(parent), "%s", pubdir);
+   if(base == pubdir) strcpy(parent, ".");
+   else if(base == pubdir + 1) strcpy(parent, "/");
+   else parent[base - pubdir - 1] = '\0';
+   if(stat(parent, &pst) != 0 || st.st_dev != pst.st_dev ||
+      (statx(AT_FDCWD, pubdir, 0, STATX_BASIC_STATS, &stx) == 0 &&
+       (stx.stx_attributes_mask & stx.stx_attributes & STATX_ATTR_MOUNT_ROOT))) {
+      printf("Error: output folder %s is a mount point or not on the file system of %s,\n", pubdir, parent);
+      printf("       it cannot be replaced by rename. Use a folder below it.\n");
+      exit(-1);
+   }
+}
+
+/* ------------------------------------------------------------ *
+ * publish_data() makes the complete dataset in the staging    *
+ * folder outdir visible as pubdir in one step: a new pubdir   *
+ * is a rename, an existing one is swapped with renameat2()    *
+ * RENAME_EXCHANGE, so readers see either the old or the new   *
+ * dataset, never a partial one. Folders that are not part of  *
+ * the dataset move over first, then the old one is discarded. *
+ * File systems without RENAME_EXCHANGE get two renames, with  *
+ * a short time without pubdir in between.                      *
+ * ------------------------------------------------------------ */
+void publish_data() {
+   char oldpath[300];
+   struct stat st;
+   int fromfd, tofd;
+
+   if(stat(pubdir, &st) != 0) {
+      if(rename(outdir, pubdir) != 0) {
+         printf("Error rename %s to %s\n", outdir, pubdir);
+         exit(-1);
+      }
+   }
+   else {
+      if((fromfd = open(pubdir, O_RDONLY | O_DIRECTORY)) >= 0) {
+         if((tofd = open(outdir, O_RDONLY | O_DIRECTORY)) >= 0) keep_tree(fromfd, tofd, 0);
+         else close(fromfd);
+      }
+      if(renameat2(AT_FDCWD, outdir, AT_FDCWD, pubdir, RENAME_EXCHANGE) == 0) discard_data(outdir);
+      else {
+         snprintf(oldpath, sizeof(oldpath), "%s.old-%d", pubdir, (int) getpid());
+         if(rename(pubdir, oldpath) != 0 || rename(outdir, pubdir) != 0) {
+            printf("Error rename %s to %s\n", outdir, pubdir);
+            exit(-1);
+         }
+         discard_data(oldpath);
+      }
+   }
+   printf("Published dataset [%s]\n", pubdir);
+}
+
+/* ------------------------------------------------------------ *
+ * run_digest() returns a 48 bit FNV-1a hash of the options and *
+ * period of the run, dset.txt records it for --resume          *
+ * ------------------------------------------------------------ */
+unsigned long long run_digest() {
+   char text[1344];
+   uint64_t h = 14695981039346656037ULL;
+   const char *p;
+
+   snprintf(text, sizeof(text), "%s|%lld|%lld", runparams, (long long) periodstart, (long long) periodend);
+   for(p = text; *p; p++) h = (h ^ (uint8_t) *p) * 1099511628211ULL;
+   return (unsigned long long) (h & 0xffffffffffffULL);
+}
+
+/* ------------------------------------------------------------ *
+ * dset_complete() returns 1 if the dataset file fpath has the  *
+ * run digest of this run's options and period, else 0          *
+ * ------------------------------------------------------------ */
+int dset_complete(const char *fpath) {
+   char line[80];
+   unsigned long long digest;
+   int found = 0;
+   FILE *dset;
+
+   if(! (dset=fopen(fpath, "r"))) return 0;
+   while(fgets(line, sizeof(line), dset))
+      if(sscanf(line, "run-digest: %llx", &digest) == 1 && digest == run_digest()) found = 1;
+   fclose(dset);
+   return found;
+}
+
+/* ------------------------------------------------------------ *
+ * write_dsetfile() create the dataset description file         *
+ * ------------------------------------------------------------ */
+void write_dsetfile(spa_data spa, int num) {
+   FILE *dset;
+   char fpath[1024];
+   snprintf(fpath, sizeof(fpath), "%s/%s", outdir, dsetfile);
+   if(! (dset=fopen(fpath, "w"))) {
+      printf("Error open %s for writing.\n", fpath);
+      exit(-1);
+   }
+   else printf("Create dataset file [%s]\n", fpath);
+
+   fprintf(dset, "prgversion: %s\n", progver);
+   fprintf(dset, "prgrundate: %s\n", rundate);
+   fprintf(dset, "start-date: %d%02d%02d\n", spa.year, spa.month, spa.day);
+   fprintf(dset, "locationlg: %f\n", spa.longitude);
+   fprintf(dset, "locationla: %f\n", spa.latitude);
+   fprintf(dset, "locationtz: %f\n", spa.timezone);
+   fprintf(dset, "mag-declin: %f\n", mdeclination);
+   fprintf(dset, "dayfiles-#: %d\n", num);
+   if(chebyshev) fprintf(dset, "daybinsize: %ld Bytes\n", sizeof(struct chebday));
+   else fprintf(dset, "daybinsize: %ld Bytes\n", sizeof(struct brecord));
+   fprintf(dset, "srsbinsize: %ld Bytes\n", sizeof(struct drecord));
+   if(tolerance > 0) {
+      fprintf(dset, "day-layout: adaptive\n");
+      fprintf(dset, "adapt-tolr: %f\n", tolerance);
+      fprintf(dset, "adapt-maxe: %f\n", maxerror);
+   }
+   if(chebyshev) {
+      fprintf(dset, "day-layout: cheby\n");
+      fprintf(dset, "cheb-segms: %d\n", CHEB_SEGMENTS);
+      fprintf(dset, "cheb-order: %d\n", CHEB_ORDER);
+      fprintf(dset, "cheb-maxer: %f\n", chebmaxerr);
+   }
+   if(daylight) fprintf(dset, "day-layout: daylight\n");
+   if(srsslots) fprintf(dset, "srs-layout: slots\n");
+   if(dirtree) fprintf(dset, "dir-layout: yyyy/mm\n");
+   if(blockalign) fprintf(dset, "blockalign: %d\n", blockalign);
+   if(columns) fprintf(dset, "day-layout: columns\n");
+   if(residual) {
+      fprintf(dset, "day-layout: residual\n");
+      fprintf(dset, "resid-refy: %d\n", refyear);
+      fprintf(dset, "resid-days: %ld\n", resdays);
+   }
+   if(checkpoints) fprintf(dset, "run-digest: %012llx\n", run_digest());
+   fclose(dset);
+}
+
+/* ------------------------------------------------------------ *
+ * dayfile_params() returns all inputs of a day file but its   *
+ * date as text: program and engine version, site, timezone,   *
+ * the process TZ, interval and day file layout                 *
+ * ------------------------------------------------------------ */
+void dayfile_params(char *buf, size_t len) {
+   snprintf(buf, len, "suncalc %s %s x=%f y=%f tz=%f i=%d TZ=%s zone=%s/%s daylight=%d columns=%d blockalign=%d",
+            progver, sun_engine(), longitude, latitude, tz, interval, getenv("TZ") ? getenv("TZ") : "",
+            tzname[0], tzname[1], daylight, columns, blockalign);
+}
+
+/* ------------------------------------------------------------ *
+ * write_checkpoint() records that all days before year-month- *
+ * day are complete. Their files are flushed to disk first with *
+ * syncfs(), then the checkpoint replaces the old one through a *
+ * synced temp file and rename(), so a crash leaves either one. *
+ * The srs files of the year get their size, later records are *
+ * cut off on resume.                                           *
+ * ------------------------------------------------------------ */
+void write_checkpoint(int year, int month, int day) {
+   struct tm next_tm = { 0 };
+   struct stat st;
+   char fpath[1024], tpath[1024];
+   FILE *ckpt;
+   int dirfd;
+
+   next_tm.tm_year = year - 1900;
+   next_tm.tm_mon = month - 1;
+   next_tm.tm_mday = day;
+   next_tm.tm_isdst = -1;
+   if(awrite_sync() != 0) exit(-1);
+   if((dirfd = open(outdir, O_RDONLY | O_DIRECTORY)) < 0 || syncfs(dirfd) != 0) {
+      printf("Error sync %s for the checkpoint\n", outdir);
+      exit(-1);
+   }
+   snprintf(tpath, sizeof(tpath), "%s/%s.tmp", outdir, ckptfile);
+   if(! (ckpt=fopen(tpath, "w"))) {
+      printf("Error open %s for writing\n", tpath);
+      exit(-1);
+   }
+   fprintf(ckpt, "prgversion: %s\n", progver);
+   fprintf(ckpt, "run-params: %s\n", runparams);
+   fprintf(ckpt, "period-beg: %lld\n", (long long) periodstart);
+   fprintf(ckpt, "period-end: %lld\n", (long long) periodend);
+   fprintf(ckpt, "next-daybg: %lld\n", (long long) mktime(&next_tm));
+   fprintf(ckpt, "next-dated: %04d%02d%02d\n", year, month, day);
+   snprintf(fpath, sizeof(fpath), "%s/srs-%04d.bin", outdir, year);
+   fprintf(ckpt, "srs-binsiz: %lld\n", stat(fpath, &st) == 0 ? (long long) st.st_size : -1LL);
+   snprintf(fpath, sizeof(fpath), "%s/srs-%04d.csv", outdir, year);
+   fprintf(ckpt, "srs-csvsiz: %lld\n", stat(fpath, &st) == 0 ? (long long) st.st_size : -1LL);
+   fprintf(ckpt, "adapt-rows: %ld %ld\n", allrows, keptrows);
+   fprintf(ckpt, "adapt-maxe: %.17g\n", maxerror);
+   fprintf(ckpt, "cheb-maxer: %.17g\n", chebmaxerr);
+   if(fflush(ckpt) != 0 || fsync(fileno(ckpt)) != 0 || fclose(ckpt) != 0) {
+      printf("Error write %s\n", tpath);
+      exit(-1);
+   }
+   snprintf(fpath, sizeof(fpath), "%s/%s", outdir, ckptfile);
+   if(rename(tpath, fpath) != 0 || fsync(dirfd) != 0) {
+      printf("Error write %s\n", fpath);
+      exit(-1);
+   }
+   close(dirfd);
+   printf("Checkpoint [%s] before %04d-%02d-%02d\n", fpath, year, month, day);
+   lastckpt = time(NULL);
+}
+
+/* ------------------------------------------------------------ *
+ * read_checkpoint() sets next to the first day that is not    *
+ * complete, and restores the dataset files and summaries to   *
+ * the checkpoint: srs records after it are cut off, srs files *
+ * of later years removed. Returns 0, or -1 if outdir has no   *
+ * checkpoint. A checkpoint of other options is an error.      *
+ * ------------------------------------------------------------ */
+int read_checkpoint(time_t *next) {
+   char fpath[1024], line[1536], params[1280] = "";
+   long long beg = 0, end = 0, day = -1, binsize = -1, csvsize = -1;
+   int date = 0, year, endyear;
+   FILE *ckpt;
+
+   snprintf(fpath, sizeof(fpath), "%s/%s", outdir, ckptfile);
+   if(! (ckpt=fopen(fpath, "r"))) return -1;
+   while(fgets(line, sizeof(line), ckpt)) {
+      line[strcspn(line, "\n")] = '\0';
+      if(strncmp(line, "run-params: ", 12) == 0) snprintf(params, sizeof(params), "%.1279s", line + 12);
+      sscanf(line, "period-beg: %lld", &beg);
+      sscanf(line, "period-end: %lld", &end);
+      sscanf(line, "next-daybg: %lld", &day);
+      sscanf(line, "next-dated: %d", &date);
+      sscanf(line, "srs-binsiz: %lld", &binsize);
+      sscanf(line, "srs-csvsiz: %lld", &csvsize);
+      sscanf(line, "adapt-rows: %ld %ld", &allrows, &keptrows);
+      sscanf(line, "adapt-maxe: %lf", &maxerror);
+      sscanf(line, "cheb-maxer: %lf", &chebmaxerr);
+   }
+   fclose(ckpt);
+   if(strcmp(params, runparams) != 0 || beg != periodstart || end != periodend || day < beg || day > end) {
+      printf("Error: %s is from a run with other options or period, cannot resume.\n", fpath);
+      exit(-1);
+   }
+
+   year = date / 10000;
+   snprintf(fpath, sizeof(fpath), "%s/srs-%04d.bin", outdir, year);
+   if(binsize < 0) unlink(fpath);
+   else if(truncate(fpath, binsize) != 0) {
+      printf("Error cut %s to the checkpoint\n", fpath);
+      exit(-1);
+   }
+   snprintf(fpath, sizeof(fpath), "%s/srs-%04d.csv", outdir, year);
+   if(csvsize < 0) unlink(fpath);
+   else if(truncate(fpath, csvsize) != 0) {
+      printf("Error cut %s to the checkpoint\n", fpath);
+      exit(-1);
+   }
+   endyear = localtime(&periodend)->tm_year + 1900;
+   while(++year <= endyear) {
+      snprintf(fpath, sizeof(fpath), "%s/srs-%04d.bin", outdir, year);
+      unlink(fpath);
+      snprintf(fpath, sizeof(fpath), "%s/srs-%04d.csv", outdir, year);
+      unlink(fpath);
+   }
+   *next = day;
+   return 0;
+}
+
+/* ----------------------------------------------------------- *
+ * dayfile_path() returns the path of the days file with the   *
+ * extension ext: outdir/yyyymmdd.ext, or outdir/yyyy/mm/dd.ext *
+ * with the '-d' folder layout, creating the folders if needed. *
+ * datefile_path() is the same for a date without its dayset.  *
+ * ----------------------------------------------------------- */
+void datefile_path(char *fpath, size_t len, int year, int month, int day, const char *ext) {
+   if(dirtree) {
+      snprintf(fpath, len, "%s/%04d", outdir, year);
+      if(mkdir(fpath, 0700) == 0) printf("Created new output folder [%s]\n", fpath);
+      snprintf(fpath, len, "%s/%04d/%02d", outdir, year, month);
+      if(mkdir(fpath, 0700) == 0) printf("Created new output folder [%s]\n", fpath);
+      else if(errno != EEXIST) {
+         printf("Error create folder %s\n", fpath);
+         exit(-1);
+      }
+      snprintf(fpath, len, "%s/%04d/%02d/%02d.%s", outdir, year, month, day, ext);
+   }
+   else snprintf(fpath, len, "%s/%04d%02d%02d.%s", outdir, year, month, day, ext);
+}
+
+void dayfile_path(char *fpath, size_t len, const struct dayset *d, const char *ext) {
+   datefile_path(fpath, len, d->year, d->month, d->day, ext);
+}
+
+/* ----------------------------------------------------------- *
+ * azimuthdiff() returns the angle between two azimuth values, *
+ * taking the wrap-around at north (0/360 degrees) into account *
+ * ----------------------------------------------------------- */
+double azimuthdiff(double a, double b) {
+   double diff = fabs(a - b);
+   if(diff > 180) diff = 360 - diff;
+   return diff;
+}
+
+/* ----------------------------------------------------------- *
+ * pointingdiff() returns the angle between two sun directions *
+ * given as azimuth/zenith pairs, the tracker pointing error.  *
+ * Near the zenith, a large azimuth difference is a small one. *
+ * ----------------------------------------------------------- */
+double pointingdiff(double az1, double ze1, double az2, double ze2) {
+   double c = cos(deg2rad(ze1)) * cos(deg2rad(ze2)) +
+              sin(deg2rad(ze1)) * sin(deg2rad(ze2)) * cos(deg2rad(az1 - az2));
+   if(c > 1) c = 1;
+   if(c < -1) c = -1;
+   return rad2deg(acos(c));
+}
+
+/* ----------------------------------------------------------- *
+ * adaptive_rows() selects the day records to keep in adaptive *
+ * mode. A record is kept if the dayflag changes, or if azimuth *
+ * or zenith moved more than the tolerance since the last kept  *
+ * record. The tracker holds the last record until the next, so *
+ * the skipped records define the error. Night records are only *
+ * kept at the dayflag change, the tracker does not use them.   *
+ * Returns the number of kept records, their row index in keep. *
+ * ----------------------------------------------------------- */
+int adaptive_rows(const struct dayset *d, int *keep) {
+   int i, last = 0, num = 0;
+   double err;
+
+   keep[num++] = 0;
+   for(i = 1; i < d->rows; i++) {
+      if(d->dflag[i] != d->dflag[last]) {
+         keep[num++] = i;
+         last = i;
+         continue;
+      }
+      if(d->dflag[i] == 0) continue;
+      err = fmax(azimuthdiff(d->azimuth[i], d->azimuth[last]),
+                 fabs(d->zenith[i] - d->zenith[last]));
+      if(err > tolerance) {
+         keep[num++] = i;
+         last = i;
+      }
+      else if(err > maxerror) maxerror = err;
+   }
+   allrows += d->rows;
+   keptrows += num;
+   if(verbose == 1) printf("Debug: adaptive rows kept [%d/%d]\n", num, d->rows);
+   return num;
+}
+
+/* ----------------------------------------------------------- *
+ * write_dayindex() creates the yyyymmdd.idx hour index file   *
+ * for adaptive day files: 25 uint16_t values, entry h is the  *
+ * first record at or after hour h, entry 24 the record count. *
+ * ----------------------------------------------------------- */
+void write_dayindex(const struct dayset *d, const int *keep, int num) {
+   FILE *fidx;
+   char fpath[1024];
+   uint16_t idx[25];
+   int h, i = 0;
+
+   for(h = 0; h < 24; h++) {
+      while(i < num && d->hour[keep[i]] < h) i++;
+      idx[h] = i;
+   }
+   idx[24] = num;
+
+   dayfile_path(fpath, sizeof(fpath), d, "idx");
+   if(! (fidx=awrite_open(fpath))) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
+   } else printf("Create day idx file [%s]\n", fpath);
+   fwrite(idx, sizeof(idx), 1, fidx);
+   awrite_close(fidx);
+}
+
+/* ----------------------------------------------------------- *
+ * spa_position() calculates azimuth and zenith for the day in *
+ * spa at the given (fractional) second of the day.            *
+ * ----------------------------------------------------------- */
+void spa_position(spa_data spa, double sec, double *azimuth, double *zenith) {
+   int result;
+   spa.hour     = (int) (sec / 3600);
+   spa.minute   = (int) ((sec - spa.hour * 3600) / 60);
+   spa.second   = sec - spa.hour * 3600 - spa.minute * 60;
+   spa.function = SPA_ZA;
+   result = spa_calculate(&spa);
+   if(result > 0) handle_spa_errors(spa, result);
+   *azimuth = spa.azimuth;
+   *zenith  = spa.zenith;
+}
+
+/* ----------------------------------------------------------- *
+ * cheb_fit() turns the angle values at the Chebyshev nodes of *
+ * a segment into coefficients, stored in 1/64 degree units.   *
+ * ----------------------------------------------------------- */
+void cheb_fit(const double *f, int16_t *coef) {
+   int j, k;
+   double sum;
+
+   for(k = 0; k < CHEB_ORDER; k++) {
+      sum = 0;
+      for(j = 0; j < CHEB_ORDER; j++)
+         sum += f[j] * cos(M_PI * k * (j + 0.5) / CHEB_ORDER);
+      sum = sum * 2 / CHEB_ORDER;
+      if(k == 0) sum = sum / 2;
+      sum = round(sum * CHEB_SCALE);
+      if(sum > INT16_MAX) sum = INT16_MAX;
+      if(sum < INT16_MIN) sum = INT16_MIN;
+      coef[k] = (int16_t) sum;
+   }
+}
+
+/* ----------------------------------------------------------- *
+ * progmem_srs() keeps the srs record of a day for the header  *
+ * ----------------------------------------------------------- */
+void progmem_srs(const struct drecord *srs) {
+   if(! (flash.srs = realloc(flash.srs, (flash.srsdays + 1) * sizeof(struct drecord)))) {
+      printf("Error: out of memory for flash data\n");
+      exit(-1);
+   }
+   flash.srs[flash.srsdays++] = *srs;
+}
+
+/* ----------------------------------------------------------- *
+ * progmem_cheb() keeps a Chebyshev day for the header         *
+ * ----------------------------------------------------------- */
+void progmem_cheb(const struct chebday *cd) {
+   if(! (flash.cheb = realloc(flash.cheb, (flash.days + 1) * sizeof(struct chebday)))) {
+      printf("Error: out of memory for flash data\n");
+      exit(-1);
+   }
+   flash.cheb[flash.days++] = *cd;
+}
+
+/* ----------------------------------------------------------- *
+ * progmem_day() keeps the daylight positions of a day for the *
+ * header, rounded to 1/100 degree                             *
+ * ----------------------------------------------------------- */
+void progmem_day(const struct dayset *d) {
+   struct dayhead dh = { 0, 0, 0, interval };
+   int i;
+
+   flash.head = realloc(flash.head, (flash.days + 1) * sizeof(struct dayhead));
+   flash.start = realloc(flash.start, (flash.days + 1) * sizeof(uint32_t));
+   flash.pos = realloc(flash.pos, (flash.npos + d->rows) * sizeof(flash.pos[0]));
+   if(! flash.head || ! flash.start || ! flash.pos) {
+      printf("Error: out of memory for flash data\n");
+      exit(-1);
+   }
+   flash.start[flash.days] = flash.npos;
+   for(i = 0; i < d->rows; i++) {
+      if(d->dflag[i] == 0) continue;
+      if(dh.count == 0) {
+         dh.hour   = d->hour[i];
+         dh.minute = d->minute[i];
+      }
+      flash.pos[flash.npos][0] = sunread_centideg((uint8_t *) &d->azimuth[i]) % 36000;
+      flash.pos[flash.npos][1] = sunread_centideg((uint8_t *) &d->zenith[i]);
+      flash.npos++;
+      dh.count++;
+   }
+   flash.head[flash.days++] = dh;
+}
+
+/* ----------------------------------------------------------- *
+ * write_progmem() checks the flash data size against the     *
+ * budget, and creates the C header sundata.h with the dataset *
+ * parameters, the srs records and the day data as const       *
+ * PROGMEM arrays. No header is written if the data is too big. *
+ * ----------------------------------------------------------- */
+void write_progmem(spa_data spa) {
+   FILE *fh;
+   char fpath[1024];
+   long size, i;
+   int j, k;
+
+   size = flash.srsdays * sizeof(struct drecord);
+   if(chebyshev) size += flash.days * sizeof(struct chebday);
+   else size += flash.days * (sizeof(struct dayhead) + sizeof(uint32_t)) + flash.npos * sizeof(flash.pos[0]);
+   printf("Flash data: %ld bytes, budget %ld bytes (%.1f%%)\n", size, flashlimit, 100.0 * size / flashlimit);
+   if(size > flashlimit) {
+      printf("Error: flash data exceeds the budget of %ld bytes, try -c, a larger -i, or a shorter -p.\n", flashlimit);
+      exit(-1);
+   }
+
+   snprintf(fpath, sizeof(fpath), "%s/sundata.h", outdir);
+   if(! (fh=fopen(fpath, "w"))) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
+   } else printf("Create flash header file [%s]\n", fpath);
+
+   fprintf(fh, "/* ------------------------------------------------------------ *\n");
+   fprintf(fh, " * file:        sundata.h, created by suncalc v%-17s*\n", progver);
+   fprintf(fh, " * purpose:     sun position dataset for flash, no SD card      *\n");
+   fprintf(fh, " *                                                              *\n");
+   fprintf(fh, " * Include it in one source file only, it defines the arrays.   *\n");
+   fprintf(fh, " * Day and srs entry n is the date DSET_START_DATE + n days.    *\n");
+   fprintf(fh, " * ------------------------------------------------------------ */\n");
+   fprintf(fh, "#ifndef SUNDATA_H\n#define SUNDATA_H\n\n");
+   fprintf(fh, "#include <stdint.h>\n#include \"sunread.h\"\n");
+   fprintf(fh, "#ifdef ARDUINO\n#include <Arduino.h>\n#endif\n");
+   fprintf(fh, "#ifndef PROGMEM\n#define PROGMEM\n#endif\n\n");
+
+   /* -------------------------------------------------------- *
+    * the dset.txt parameters                                  *
+    * -------------------------------------------------------- */
+   fprintf(fh, "#define DSET_PRGVERSION \"%s\"\n", progver);
+   fprintf(fh, "#define DSET_PRGRUNDATE \"%s\"\n", rundate);
+   fprintf(fh, "#define DSET_START_DATE %d%02d%02d\n", spa.year, spa.month, spa.day);
+   fprintf(fh, "#define DSET_LOCATIONLG %f\n", spa.longitude);
+   fprintf(fh, "#define DSET_LOCATIONLA %f\n", spa.latitude);
+   fprintf(fh, "#define DSET_LOCATIONTZ %f\n", spa.timezone);
+   fprintf(fh, "#define DSET_MAG_DECLIN %f\n", mdeclination);
+   fprintf(fh, "#define DSET_DAYFILES   %d\n", flash.days);
+   fprintf(fh, "#define DSET_INTERVAL   %d\n", interval);
+   fprintf(fh, "#define DSET_DAY_LAYOUT_%s\n", chebyshev ? "CHEBY" : "DAYLIGHT");
+   fprintf(fh, "#define DSET_FLASHBYTES %ld\n\n", size);
+
+   /* -------------------------------------------------------- *
+    * srs records as bytes, same as in the srs-yyyy.bin file   *
+    * -------------------------------------------------------- */
+   fprintf(fh, "const uint8_t sundata_srs[%d][SRSREC_SIZE] PROGMEM = {\n", flash.srsdays);
+   for(i = 0; i < flash.srsdays; i++) {
+      const uint8_t *b = (const uint8_t *) &flash.srs[i];
+      fprintf(fh, "   {");
+      for(j = 0; j < (int) sizeof(struct drecord); j++) fprintf(fh, "%s%u", j ? "," : " ", b[j]);
+      fprintf(fh, " },\n");
+   }
+   fprintf(fh, "};\n\n");
+
+   /* -------------------------------------------------------- *
+    * day data: Chebyshev days for sunread_cheb(), or daylight *
+    * headers for sunread_daylight_record() plus positions     *
+    * -------------------------------------------------------- */
+   if(chebyshev) {
+      fprintf(fh, "const struct chebday sundata_cheb[%d] PROGMEM = {\n", flash.days);
+      for(i = 0; i < flash.days; i++) {
+         const struct chebday *c = &flash.cheb[i];
+         fprintf(fh, "   { { %u, %u, %u, %u, %u, %u },\n", c->head.risesec, c->head.transitsec,
+                 c->head.setsec, c->head.segments, c->head.order, c->head.maxerr);
+         for(k = 0; k < CHEB_SEGMENTS * 2; k++) {
+            const int16_t *v = (k < CHEB_SEGMENTS) ? c->azimuth[k] : c->zenith[k - CHEB_SEGMENTS];
+            fprintf(fh, "%s{", k % CHEB_SEGMENTS ? " " : "     { ");
+            for(j = 0; j < CHEB_ORDER; j++) fprintf(fh, "%s%d", j ? ", " : " ", v[j]);
+            fprintf(fh, " }%s", k % CHEB_SEGMENTS < CHEB_SEGMENTS - 1 ? "," : (k < CHEB_SEGMENTS ? " },\n" : " } },\n"));
+         }
+      }
+      fprintf(fh, "};\n\n");
+   }
+   else {
+      fprintf(fh, "const struct dayhead sundata_dayhead[%d] PROGMEM = {\n", flash.days);
+      for(i = 0; i < flash.days; i++)
+         fprintf(fh, "   { %u, %u, %u, %u },\n", flash.head[i].hour, flash.head[i].minute,
+                 flash.head[i].count, flash.head[i].interval);
+      fprintf(fh, "};\n\n");
+      fprintf(fh, "const uint32_t sundata_daystart[%d] PROGMEM = {", flash.days);
+      for(i = 0; i < flash.days; i++) fprintf(fh, "%s%u,", i % 10 ? " " : "\n   ", flash.start[i]);
+      fprintf(fh, "\n};\n\n");
+      fprintf(fh, "/* azimuth and zenith in 1/100 degree */\n");
+      fprintf(fh, "const uint16_t sundata_position[%ld][2] PROGMEM = {", flash.npos);
+      for(i = 0; i < flash.npos; i++)
+         fprintf(fh, "%s{ %u, %u },", i % 8 ? " " : "\n   ", flash.pos[i][0], flash.pos[i][1]);
+      fprintf(fh, "\n};\n\n");
+   }
+   fprintf(fh, "#endif\n");
+   fclose(fh);
+}
+
+/* ----------------------------------------------------------- *
+ * write_daycheb() creates the yyyymmdd.chb Chebyshev day file *
+ * The segments span from sunrise to sunset, on polar days the *
+ * full day, and on polar nights the span is left empty. Each  *
+ * file is checked against the calculated day records with the *
+ * MCU evaluator in sunread.c, the max pointing error is stored *
+ * with it.                                                     *
+ * ----------------------------------------------------------- */
+void write_daycheb(const struct dayset *d) {
+   FILE *fdayh;
+   char fpath[1024];
+   struct chebday cd;
+   double azi[CHEB_ORDER], zen[CHEB_ORDER];
+   double err, maxerr = 0;
+   int32_t a, b, caz, cze;
+   int j, k, r;
+
+   memset(&cd, 0, sizeof(cd));
+   cd.head.segments = CHEB_SEGMENTS;
+   cd.head.order    = CHEB_ORDER;
+   if(d->spa.sunrise >= 0 && d->spa.sunset >= 0) {
+      cd.head.risesec = (uint32_t) fmax(0, floor(d->spa.sunrise * 3600));
+      cd.head.setsec  = (uint32_t) fmin(86400, ceil(d->spa.sunset * 3600));
+   }
+   else if(d->spa.sta > 0) {         // polar day, sun never sets
+      cd.head.risesec = 0;
+      cd.head.setsec  = 86400;
+   }
+   cd.head.transitsec = (uint32_t) fmin(cd.head.setsec, fmax(cd.head.risesec, round(d->spa.suntransit * 3600)));
+
+   /* -------------------------------------------------------- *
+    * fit each segment from its Chebyshev node positions. The  *
+    * azimuth is unwrapped along the nodes in time order, and  *
+    * the mean is moved into -180..180 to fit into int16_t.    *
+    * -------------------------------------------------------- */
+   for(k = 0; k < CHEB_SEGMENTS && cd.head.setsec > cd.head.risesec; k++) {
+      int half      = CHEB_SEGMENTS / 2;   // same split as sunread_cheb_segment()
+      int32_t start = (k < half) ? cd.head.risesec : cd.head.transitsec;
+      int32_t len   = (k < half) ? cd.head.transitsec - cd.head.risesec
+                                 : cd.head.setsec - cd.head.transitsec;
+      int num       = (k < half) ? half : CHEB_SEGMENTS - half;
+      int n         = (k < half) ? k : k - half;
+      a = start + (len * n) / num;
+      b = start + (len * (n + 1)) / num;
+      if(b <= a) continue;
+      for(j = CHEB_ORDER - 1; j >= 0; j--) {
+         double sec = (a + b) / 2.0 + cos(M_PI * (j + 0.5) / CHEB_ORDER) * (b - a) / 2.0;
+         spa_position(d->spa, sec, &azi[j], &zen[j]);
+         if(j < CHEB_ORDER - 1) {
+            while(azi[j] - azi[j+1] > 180) azi[j] -= 360;
+            while(azi[j] - azi[j+1] < -180) azi[j] += 360;
+         }
+      }
+      cheb_fit(azi, cd.azimuth[k]);
+      cheb_fit(zen, cd.zenith[k]);
+      while(cd.azimuth[k][0] >= 180 * CHEB_SCALE) cd.azimuth[k][0] -= 360 * CHEB_SCALE;
+      while(cd.azimuth[k][0] < -180 * CHEB_SCALE) cd.azimuth[k][0] += 360 * CHEB_SCALE;
+   }
+
+   /* -------------------------------------------------------- *
+    * verify the coefficients against the calculated records   *
+    * -------------------------------------------------------- */
+   for(r = 0; r < d->rows; r++) {
+      if(! sunread_cheb(&cd, d->hour[r] * 3600 + d->minute[r] * 60, &caz, &cze)) continue;
+      err = pointingdiff(caz / 100.0, cze / 100.0, d->azimuth[r], d->zenith[r]);
+      if(err > maxerr) maxerr = err;
+   }
+   cd.head.maxerr = (uint16_t) fmin(UINT16_MAX, ceil(maxerr * 100));
+   if(maxerr > chebmaxerr) chebmaxerr = maxerr;
+   if(verbose == 1) printf("Debug: cheb span [%d-%d-%d] max error [%.3f]\n",
+                            cd.head.risesec, cd.head.transitsec, cd.head.setsec, maxerr);
+
+   if(strcmp(format, "progmem") == 0) progmem_cheb(&cd);
+   dayfile_path(fpath, sizeof(fpath), d, "chb");
+   if(! (fdayh=awrite_open(fpath))) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
+   } else printf("Create day chb file [%s]\n", fpath);
+   fwrite(&cd, sizeof(cd), 1, fdayh);
+   awrite_close(fdayh);
+}
+
+/* ----------------------------------------------------------- *
+ * npy_header() writes the 128 byte NumPy .npy v1.0 header for *
+ * a 1-dimensional array. The fixed size lets npy_close() put  *
+ * the final row count in place after all days are written.   *
+ * ----------------------------------------------------------- */
+void npy_header(FILE *f, const char *descr, long rows) {
+   char head[NPYHEAD];
+   int len;
+
+   memset(head, ' ', sizeof(head));
+   memcpy(head, "\x93NUMPY\x01\x00", 8);
+   head[8] = (NPYHEAD - 10) & 0xff;
+   head[9] = (NPYHEAD - 10) >> 8;
+   len = snprintf(head + 10, NPYHEAD - 10, "{'descr': '%s', 'fortran_order': False, 'shape': (%ld,), }",
+                  descr, rows);
+   head[10 + len] = ' ';
+   head[NPYHEAD - 1] = '\n';
+   fseek(f, 0, SEEK_SET);
+   fwrite(head, sizeof(head), 1, f);
+}
+
+/* ----------------------------------------------------------- *
+ * npy_open() creates the column files time.npy, azimuth.npy,  *
+ * zenith.npy and dflag.npy under the outdir folder.           *
+ * ----------------------------------------------------------- */
+void npy_open() {
+   char fpath[1024];
+   int c;
+
+   for(c = 0; c < NPYCOLS; c++) {
+      snprintf(fpath, sizeof(fpath), "%s/%s.npy", outdir, npycols[c].name);
+      if(! (npycols[c].file=fopen(fpath, "w"))) {
+         printf("Error open %s for writing\n", fpath);
+         exit(-1);
+      } else printf("Create npy column file [%s]\n", fpath);
+      npy_header(npycols[c].file, npycols[c].descr, 0);
+   }
+}
+
+/* ----------------------------------------------------------- *
+ * npy_append() adds all rows of a day to the column files, as *
+ * one write of each contiguous dayset column array.           *
+ * ----------------------------------------------------------- */
+void npy_append(const struct dayset *d) {
+   fwrite(d->time, sizeof(d->time[0]), d->rows, npycols[0].file);
+   fwrite(d->azimuth, sizeof(d->azimuth[0]), d->rows, npycols[1].file);
+   fwrite(d->zenith, sizeof(d->zenith[0]), d->rows, npycols[2].file);
+   fwrite(d->dflag, sizeof(d->dflag[0]), d->rows, npycols[3].file);
+   npyrows += d->rows;
+}
+
+/* ----------------------------------------------------------- *
+ * npy_close() writes the final row count and closes the files *
+ * ----------------------------------------------------------- */
+void npy_close() {
+   int c;
+
+   for(c = 0; c < NPYCOLS; c++) {
+      npy_header(npycols[c].file, npycols[c].descr, npyrows);
+      fclose(npycols[c].file);
+   }
+}
+
+#ifdef HAVE_SQLITE
+/* ----------------------------------------------------------- *
+ * SQLite sink for '-q dbfile'. All runs add to the same three *
+ * tables, so a fleet of sites can be loaded one run per site: *
+ * site   -> one row per longitude/latitude                    *
+ * sample -> all calculated rows, date yyyymmdd and minute of  *
+ *           the day in local time, plus the unix time         *
+ * srs    -> one row per day, times as minute of the day       *
+ * The rows go through prepared statements in one transaction  *
+ * per run. The indexes are dropped before and built after the *
+ * load, unless the tables already hold more rows than the run *
+ * adds, then updating them in place is cheaper.               *
+ * ----------------------------------------------------------- */
+sqlite3 *db = NULL;                  // the open database
+sqlite3_stmt *sqlsample = NULL;      // prepared sample insert
+sqlite3_stmt *sqlsrs = NULL;         // prepared srs insert
+sqlite3_int64 sqlsite = 0;           // site id of this run
+long sqlrows = 0;                    // sample rows inserted
+int sqlreindex = 0;                  // indexes were dropped, build them at close
+
+static const char sqlschema[] =
+   "CREATE TABLE IF NOT EXISTS site (id INTEGER PRIMARY KEY, longitude REAL, latitude REAL,"
+   " timezone REAL, UNIQUE(longitude, latitude));"
+   "CREATE TABLE IF NOT EXISTS sample (site INTEGER, time INTEGER, date INTEGER, minute INTEGER,"
+   " dflag INTEGER, azimuth REAL, zenith REAL);"
+   "CREATE TABLE IF NOT EXISTS srs (site INTEGER, date INTEGER, rise INTEGER, transit INTEGER,"
+   " sunset INTEGER, riseazimuth INTEGER, setazimuth INTEGER, transitelevation INTEGER);";
+
+static const char sqlindexes[] =
+   "CREATE INDEX IF NOT EXISTS sample_time ON sample(date, minute);"
+   "CREATE INDEX IF NOT EXISTS sample_site ON sample(site, time);"
+   "CREATE INDEX IF NOT EXISTS srs_date ON srs(site, date);"
+   "CREATE INDEX IF NOT EXISTS srs_rise ON srs(rise);";
+
+static const char sqldropindexes[] =
+   "DROP INDEX IF EXISTS sample_time; DROP INDEX IF EXISTS sample_site;"
+   "DROP INDEX IF EXISTS srs_date; DROP INDEX IF EXISTS srs_rise;";
+
+/* ----------------------------------------------------------- *
+ * sql_check() exits with the SQLite error message             *
+ * ----------------------------------------------------------- */
+void sql_check(int rc, const char *what) {
+   if(rc == SQLITE_OK || rc == SQLITE_DONE || rc == SQLITE_ROW) return;
+   printf("Error: SQLite %s [%s]: %s\n", what, dbfile, sqlite3_errmsg(db));
+   exit(-1);
+}
+
+/* ----------------------------------------------------------- *
+ * sql_date() returns the local date of t as yyyymmdd          *
+ * ----------------------------------------------------------- */
+int sql_date(time_t t) {
+   struct tm tm = *localtime(&t);
+   return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+/* ----------------------------------------------------------- *
+ * sql_open() opens or creates the database, gets the site id, *
+ * removes the rows an earlier run wrote for the same site and *
+ * period, and starts the transaction. newrows is the number   *
+ * of sample rows this run is going to add.                    *
+ * ----------------------------------------------------------- */
+void sql_open(time_t start, time_t end, long newrows) {
+   sqlite3_stmt *st;
+   sqlite3_int64 oldrows = 0;
+
+   sql_check(sqlite3_open(dbfile, &db), "open");
+   printf("Open SQLite database [%s]\n", dbfile);
+   sql_check(sqlite3_exec(db, sqlschema, NULL, NULL, NULL), "create tables");
+   sql_check(sqlite3_exec(db, "BEGIN", NULL, NULL, NULL), "begin");
+
+   sql_check(sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO site (longitude, latitude, timezone)"
+                                " VALUES (?1, ?2, ?3)", -1, &st, NULL), "prepare site");
+   sqlite3_bind_double(st, 1, longitude);
+   sqlite3_bind_double(st, 2, latitude);
+   sqlite3_bind_double(st, 3, tz);
+   sql_check(sqlite3_step(st), "insert site");
+   sqlite3_finalize(st);
+   sql_check(sqlite3_prepare_v2(db, "SELECT id FROM site WHERE longitude = ?1 AND latitude = ?2",
+                                -1, &st, NULL), "prepare site");
+   sqlite3_bind_double(st, 1, longitude);
+   sqlite3_bind_double(st, 2, latitude);
+   sql_check(sqlite3_step(st), "select site");
+   sqlsite = sqlite3_column_int64(st, 0);
+   sqlite3_finalize(st);
+
+   /* -------------------------------------------------------- *
+    * a repeated run replaces the site's rows of the period    *
+    * -------------------------------------------------------- */
+   sql_check(sqlite3_prepare_v2(db, "DELETE FROM sample WHERE site = ?1 AND time >= ?2 AND time < ?3",
+                                -1, &st, NULL), "prepare delete");
+   sqlite3_bind_int64(st, 1, sqlsite);
+   sqlite3_bind_int64(st, 2, start);
+   sqlite3_bind_int64(st, 3, end);
+   sql_check(sqlite3_step(st), "delete samples");
+   sqlite3_finalize(st);
+   sql_check(sqlite3_prepare_v2(db, "DELETE FROM srs WHERE site = ?1 AND date >= ?2 AND date < ?3",
+                                -1, &st, NULL), "prepare delete");
+   sqlite3_bind_int64(st, 1, sqlsite);
+   sqlite3_bind_int64(st, 2, sql_date(start));
+   sqlite3_bind_int64(st, 3, sql_date(end));
+   sql_check(sqlite3_step(st), "delete srs");
+   sqlite3_finalize(st);
+
+   sql_check(sqlite3_prepare_v2(db, "SELECT count(*) FROM sample", -1, &st, NULL), "prepare count");
+   sql_check(sqlite3_step(st), "count samples");
+   oldrows = sqlite3_column_int64(st, 0);
+   sqlite3_finalize(st);
+   if(oldrows <= newrows) {
+      sql_check(sqlite3_exec(db, sqldropindexes, NULL, NULL, NULL), "drop indexes");
+      sqlreindex = 1;
+   }
+   if(verbose == 1) printf("Debug: SQLite site [%lld] old rows [%lld] new rows [%ld] reindex [%d]\n",
+                           (long long) sqlsite, (long long) oldrows, newrows, sqlreindex);
+
+   sql_check(sqlite3_prepare_v2(db, "INSERT INTO sample VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7)",
+                                -1, &sqlsample, NULL), "prepare sample");
+   sql_check(sqlite3_prepare_v2(db, "INSERT INTO srs VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8)",
+                                -1, &sqlsrs, NULL), "prepare srs");
+}
+
+/* ----------------------------------------------------------- *
+ * sql_day() inserts all rows of a day into the sample table   *
+ * ----------------------------------------------------------- */
+void sql_day(const struct dayset *d) {
+   int date = d->year * 10000 + d->month * 100 + d->day;
+   int r;
+
+   for(r = 0; r < d->rows; r++) {
+      sqlite3_bind_int64(sqlsample, 1, sqlsite);
+      sqlite3_bind_int64(sqlsample, 2, d->time[r]);
+      sqlite3_bind_int(sqlsample, 3, date);
+      sqlite3_bind_int(sqlsample, 4, d->hour[r] * 60 + d->minute[r]);
+      sqlite3_bind_int(sqlsample, 5, d->dflag[r]);
+      sqlite3_bind_double(sqlsample, 6, d->azimuth[r]);
+      sqlite3_bind_double(sqlsample, 7, d->zenith[r]);
+      sql_check(sqlite3_step(sqlsample), "insert sample");
+      sqlite3_reset(sqlsample);
+   }
+   sqlrows += d->rows;
+}
+
+/* ----------------------------------------------------------- *
+ * sql_srs() inserts the srs record of a day                   *
+ * ----------------------------------------------------------- */
+void sql_srs(const struct drecord *srs, int year) {
+   sqlite3_bind_int64(sqlsrs, 1, sqlsite);
+   sqlite3_bind_int(sqlsrs, 2, year * 10000 + srs->month * 100 + srs->day);
+   sqlite3_bind_int(sqlsrs, 3, srs->risehour * 60 + srs->riseminute);
+   sqlite3_bind_int(sqlsrs, 4, srs->transithour * 60 + srs->transitminute);
+   sqlite3_bind_int(sqlsrs, 5, srs->sethour * 60 + srs->setminute);
+   sqlite3_bind_int(sqlsrs, 6, srs->riseazimuth);
+   sqlite3_bind_int(sqlsrs, 7, srs->setazimuth);
+   sqlite3_bind_int(sqlsrs, 8, srs->transitelevation);
+   sql_check(sqlite3_step(sqlsrs), "insert srs");
+   sqlite3_reset(sqlsrs);
+}
+
+/* ----------------------------------------------------------- *
+ * sql_close() builds the indexes, commits and closes the db   *
+ * ----------------------------------------------------------- */
+void sql_close() {
+   sqlite3_finalize(sqlsample);
+   sqlite3_finalize(sqlsrs);
+   if(sqlreindex) printf("Create SQLite indexes [%s]\n", dbfile);
+   sql_check(sqlite3_exec(db, sqlindexes, NULL, NULL, NULL), "create indexes");
+   sql_check(sqlite3_exec(db, "COMMIT", NULL, NULL, NULL), "commit");
+   sql_check(sqlite3_close(db), "close");
+}
+#endif
+
+/* ----------------------------------------------------------- *
+ * archive_open() creates the compressed archive.gor file      *
+ * ----------------------------------------------------------- */
+void archive_open() {
+   char fpath[1024];
+
+   snprintf(fpath, sizeof(fpath), "%s/archive.gor", outdir);
+   if(gor_create(&garch, fpath) != 0) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
+   } else printf("Create archive file [%s]\n", fpath);
+}
+
+/* ----------------------------------------------------------- *
+ * archive_append() compresses all rows of a day into one      *
+ * archive block. The decoded block is compared to the input, *
+ * so a bad archive is never left behind unnoticed.            *
+ * ----------------------------------------------------------- */
+void archive_append(const struct dayset *d) {
+   static uint8_t data[gor_maxbytes(MAXROWS)];
+   static uint8_t check[MAXROWS * DAYREC_SIZE];
+   long bytes;
+   int i;
+
+   bytes = gor_encode(data, d->rows, d->hour, d->minute, d->dflag, d->azimuth, d->zenith);
+   if(gor_decode(data, bytes, d->rows, check) != 0) {
+      printf("Error archive decode failed for %d%02d%02d\n", d->year, d->month, d->day);
+      exit(-1);
+   }
+   for(i = 0; i < d->rows; i++) {
+      uint8_t *r = check + i * DAYREC_SIZE;
+      if(r[0] != d->hour[i] || r[1] != d->minute[i] || r[2] != d->dflag[i] ||
+         memcmp(r + 3, &d->azimuth[i], sizeof(double)) != 0 ||
+         memcmp(r + 11, &d->zenith[i], sizeof(double)) != 0) {
+         printf("Error archive record %d mismatch for %d%02d%02d\n", i, d->year, d->month, d->day);
+         exit(-1);
+      }
+   }
+   if(gor_append(&garch, d->year * 10000 + d->month * 100 + d->day, d->rows, data, bytes) != 0) {
+      printf("Error writing archive block for %d%02d%02d\n", d->year, d->month, d->day);
+      exit(-1);
+   }
+   archraw += d->rows * sizeof(struct brecord);
+   archbytes += sizeof(struct gorblock) + bytes;
+}
+
+/* ----------------------------------------------------------- *
+ * stream_flush() writes the stream buffer to the stdout data  *
+ * stream. Blocking writes hold suncalc back while the reader  *
+ * is busy; a non-blocking stdout is waited on with poll().    *
+ * A reader closing the pipe (e.g. head) ends the run quietly. *
+ * ----------------------------------------------------------- */
+void stream_flush() {
+   size_t done = 0;
+   ssize_t n;
+
+   while(done < streamlen) {
+      n = write(streamfd, streambuf + done, streamlen - done);
+      if(n < 0) {
+         if(errno == EINTR) continue;
+         if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            struct pollfd pfd = { streamfd, POLLOUT, 0 };
+            poll(&pfd, 1, -1);
+            continue;
+         }
+         if(errno == EPIPE) exit(0);
+         printf("Error: stream write failed: %s\n", strerror(errno));
+         exit(-1);
+      }
+      done += n;
+   }
+   streamlen = 0;
+}
+
+/* ----------------------------------------------------------- *
+ * stream_write() adds data to the stream buffer, and flushes  *
+ * it first if the data does not fit anymore.                  *
+ * ----------------------------------------------------------- */
+void stream_write(const void *data, size_t len) {
+   if(streamlen + len > sizeof(streambuf)) stream_flush();
+   memcpy(streambuf + streamlen, data, len);
+   streamlen += len;
+}
+
+/* ----------------------------------------------------------- *
+ * stream_day() sends the selected day records to stdout, as   *
+ * 19 byte brecords, or as csv or json lines with the date.    *
+ * ----------------------------------------------------------- */
+void stream_day(const struct dayset *d, const int *keep, int num) {
+   char line[160];
+   int i, r, len;
+
+   for(i = 0; i < num; i++) {
+      r = keep[i];
+      if(strcmp(format, "csv") == 0) {
+         len = snprintf(line, sizeof(line), "%04d-%02d-%02d,%02d:%02d,%d,%.3f,%.3f\n",
+                        d->year, d->month, d->day, d->hour[r], d->minute[r],
+                        d->dflag[r], d->azimuth[r], d->zenith[r]);
+         stream_write(line, len);
+      }
+      else if(strcmp(format, "json") == 0) {
+         len = snprintf(line, sizeof(line),
+                        "{\"date\":\"%04d-%02d-%02d\",\"time\":\"%02d:%02d\",\"dflag\":%d,\"azimuth\":%.3f,\"zenith\":%.3f}\n",
+                        d->year, d->month, d->day, d->hour[r], d->minute[r],
+                        d->dflag[r], d->azimuth[r], d->zenith[r]);
+         stream_write(line, len);
+      }
+      else {
+         struct brecord frec;
+         frec.hour     = d->hour[r];
+         frec.minute   = d->minute[r];
+         frec.dflag    = d->dflag[r];
+         memcpy(frec.azimuth, &d->azimuth[r], sizeof(double));
+         memcpy(frec.zenith, &d->zenith[r], sizeof(double));
+         stream_write(&frec, sizeof(frec));
+      }
+   }
+}
+
+/* ----------------------------------------------------------- *
+ * write_padding() fills the file with zeros from the current  *
+ * offset pos up to offset end, and returns the new offset.    *
+ * ----------------------------------------------------------- */
+int32_t write_padding(FILE *f, int32_t pos, int32_t end) {
+   static const uint8_t zero[512] = { 0 };
+   int32_t len;
+
+   while(pos < end) {
+      len = end - pos;
+      if(len > (int32_t) sizeof(zero)) len = sizeof(zero);
+      fwrite(zero, 1, len, f);
+      pos += len;
+   }
+   return pos;
+}
+
+/* ----------------------------------------------------------- *
+ * residual_store() keeps a reference year day for '-r'        *
+ * ----------------------------------------------------------- */
+void residual_store(const struct dayset *d) {
+   struct refday *ref = &refdays[sunread_yday(2000, d->month, d->day)];
+
+   ref->rows = d->rows;
+   memcpy(ref->azimuth, d->azimuth, d->rows * sizeof(double));
+   memcpy(ref->zenith, d->zenith, d->rows * sizeof(double));
+}
+
+/* ----------------------------------------------------------- *
+ * write_dayresidual() creates the yyyymmdd.rsd residual day   *
+ * file for '-r', with the azimuth and zenith difference to    *
+ * the reference year in 1/100 degree. The residuals are 1    *
+ * byte if all of the day fit, else 2 bytes. Every record is   *
+ * decoded with sunread_residual() and checked. Returns -1 if  *
+ * the day has no matching reference day, then the normal day  *
+ * files are written instead.                                  *
+ * ----------------------------------------------------------- */
+int write_dayresidual(const struct dayset *d) {
+   static int32_t daz[MAXROWS], dze[MAXROWS];
+   struct refday *ref = &refdays[sunread_yday(2000, d->month, d->day)];
+   struct reshead head = { 0, 0, d->rows, 1, 0 };
+   struct brecord rrec;
+   FILE *fres;
+   char fpath[1024];
+   uint8_t res[4];
+   int32_t az, ze, max = 0;
+   int i;
+
+   if(ref->rows == 0 && d->month == 2 && d->day == 29) ref = &refdays[sunread_yday(2000, 2, 28)];
+   if(ref->rows != d->rows) return -1;
+
+   /* -------------------------------------------------------- *
+    * the day flag must be one span, its start and length go   *
+    * into the header                                          *
+    * -------------------------------------------------------- */
+   for(i = 0; i < d->rows && d->dflag[i] == 0; i++);
+   head.first = i;
+   for(; i < d->rows && d->dflag[i] == 1; i++) head.count++;
+   for(; i < d->rows; i++) if(d->dflag[i] == 1) return -1;
+
+   for(i = 0; i < d->rows; i++) {
+      daz[i] = sunread_centideg((uint8_t *) &d->azimuth[i]) - sunread_centideg((uint8_t *) &ref->azimuth[i]);
+      if(daz[i] >= 18000) daz[i] -= 36000;
+      if(daz[i] < -18000) daz[i] += 36000;
+      dze[i] = sunread_centideg((uint8_t *) &d->zenith[i]) - sunread_centideg((uint8_t *) &ref->zenith[i]);
+      if(abs(daz[i]) > max) max = abs(daz[i]);
+      if(abs(dze[i]) > max) max = abs(dze[i]);
+   }
+   if(max > 32767) return -1;
+   if(max > 127) head.size = 2;
+
+   dayfile_path(fpath, sizeof(fpath), d, "rsd");
+   if(! (fres=awrite_open(fpath))) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
+   } else printf("Create day rsd file [%s]\n", fpath);
+   fwrite(&head, sizeof(head), 1, fres);
+   for(i = 0; i < d->rows; i++) {
+      res[0] = daz[i] & 0xff;
+      res[1] = head.size == 1 ? dze[i] & 0xff : (daz[i] >> 8) & 0xff;
+      res[2] = dze[i] & 0xff;
+      res[3] = (dze[i] >> 8) & 0xff;
+      fwrite(res, 2 * head.size, 1, fres);
+
+      /* -------------------------------------------------------- *
+       * decode with the tracker code, compare to the 1/100 value *
+       * -------------------------------------------------------- */
+      memcpy(rrec.azimuth, &ref->azimuth[i], sizeof(double));
+      memcpy(rrec.zenith, &ref->zenith[i], sizeof(double));
+      if(sunread_residual(&head, i, (uint8_t *) &rrec, res, &az, &ze) != d->dflag[i] ||
+         az != (sunread_centideg((uint8_t *) &d->azimuth[i]) % 36000 + 36000) % 36000 ||
+         ze != sunread_centideg((uint8_t *) &d->zenith[i])) {
+         printf("Error residual record %d mismatch in %s\n", i, fpath);
+         exit(-1);
+      }
+   }
+   resbytes += ftell(fres);
+   awrite_close(fres);
+   resdays++;
+   return 0;
+}
+
+/* ----------------------------------------------------------- *
+ * write_daycolumns() creates the column day files for '-l':   *
+ * yyyymmdd.az and yyyymmdd.ze with the angles as double, and  *
+ * yyyymmdd.df with the day flag byte. Each file is one write  *
+ * of the dayset column array. The csv file stays the same.    *
+ * ----------------------------------------------------------- */
+void write_daycolumns(const struct dayset *d) {
+   struct { const char *ext; const void *data; size_t size; } col[3] = {
+      { "az", d->azimuth, sizeof(d->azimuth[0]) },
+      { "ze", d->zenith,  sizeof(d->zenith[0]) },
+      { "df", d->dflag,   sizeof(d->dflag[0]) }
+   };
+   FILE *fcol;
+   char fpath[1024];
+   int c, r;
+
+   for(c = 0; c < 3; c++) {
+      dayfile_path(fpath, sizeof(fpath), d, col[c].ext);
+      if(! (fcol=awrite_open(fpath))) {
+         printf("Error open %s for writing\n", fpath);
+         exit(-1);
+      } else printf("Create day %s file [%s]\n", col[c].ext, fpath);
+      fwrite(col[c].data, col[c].size, d->rows, fcol);
+      awrite_close(fcol);
+   }
+
+   dayfile_path(fpath, sizeof(fpath), d, "csv");
+   if(! (fcol=awrite_open(fpath))) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
+   } else printf("Create day csv file [%s]\n", fpath);
+   for(r = 0; r < d->rows; r++)
+      fprintf(fcol, "%02d:%02d,%d,%.3f,%.3f\n",
+              d->hour[r], d->minute[r], d->dflag[r], d->azimuth[r], d->zenith[r]);
+   awrite_close(fcol);
+}
+
+/* ----------------------------------------------------------- *
+ * write_dayfiles() writes the buffered day into the csv and   *
+ * bin files. In adaptive mode only the selected records are   *
+ * written, and the hour index file is added. In daylight mode *
+ * only the dayflag 1 records are written, after a day header. *
+ * With '-b', the records are aligned to SD card sectors.      *
+ * ----------------------------------------------------------- */
+void write_dayfiles(const struct dayset *d) {
+   FILE *fdayc, *fdayb;
+   char fpath[1024];
+   int keep[MAXROWS];
+   int i, r, num;
+
+   if(strcmp(format, "npy") == 0) npy_append(d);
+#ifdef HAVE_SQLITE
+   if(db) sql_day(d);
+#endif
+   if(archive) archive_append(d);
+   if(strcmp(format, "progmem") == 0 && ! chebyshev) progmem_day(d);
+   if(chebyshev) {
+      write_daycheb(d);
+      return;
+   }
+   if(tolerance > 0) num = adaptive_rows(d, keep);
+   else if(daylight) {
+      for(i = 0, num = 0; i < d->rows; i++)
+         if(d->dflag[i] == 1) keep[num++] = i;
+   }
+   else {
+      for(i = 0; i < d->rows; i++) keep[i] = i;
+      num = d->rows;
+   }
+   if(streamfd >= 0) {
+      stream_day(d, keep, num);
+      return;
+   }
+   if(residual) {
+      if(refyear == 0) refyear = d->year;
+      if(d->year == refyear) residual_store(d);
+      else if(write_dayresidual(d) == 0) return;
+   }
+   if(columns) {
+      write_daycolumns(d);
+      return;
+   }
+
+   /* -------------------------------------------------------- *
+    * create day csv file yyyymmdd.csv under the outdir folder *
+    * -------------------------------------------------------- */
+   dayfile_path(fpath, sizeof(fpath), d, "csv");
+   if(verbose == 1) printf("Debug: csv file name [%s]\n", fpath);
+   if(! (fdayc=awrite_open(fpath))) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
+   } else printf("Create day csv file [%s]\n", fpath);
+
+   /* -------------------------------------------------------- *
+    * create the bin file yyyymmdd.bin under the outdir folder *
+    * -------------------------------------------------------- */
+   dayfile_path(fpath, sizeof(fpath), d, "bin");
+   if(verbose == 1) printf("Debug: bin file name [%s]\n", fpath);
+   if(! (fdayb=awrite_open(fpath))) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
+   } else printf("Create day bin file [%s]\n", fpath);
+
+   /* -------------------------------------------------------- *
+    * daylight day files start with the first time and count   *
+    * -------------------------------------------------------- */
+   uint16_t hsize = daylight ? sizeof(struct dayhead) : 0;
+   int32_t pos = hsize;
+   if(daylight) {
+      struct dayhead dh;
+      dh.hour     = (num > 0) ? d->hour[keep[0]] : 0;
+      dh.minute   = (num > 0) ? d->minute[keep[0]] : 0;
+      dh.count    = num;
+      dh.interval = interval;
+      fwrite(&dh, sizeof(dh), 1, fdayb);
+   }
+
+   for(i = 0; i < num; i++) {
+      r = keep[i];
+      /* -------------------------------------------------------- *
+       * write the result to the data file using this csv format: *
+       * time hh:mm, dayflag night=0, azimuth angle, zenith angle *
+       * -------------------------------------------------------- */
+      fprintf(fdayc, "%02d:%02d,%d,%.3f,%.3f\n",
+              d->hour[r], d->minute[r], d->dflag[r], d->azimuth[r], d->zenith[r]);
+
+      /* -------------------------------------------------------- *
+       * create binary file data output                           *
+       * -------------------------------------------------------- */
+      struct brecord frec;
+      frec.hour     = d->hour[r];
+      frec.minute   = d->minute[r];
+      frec.dflag    = d->dflag[r];
+      memcpy(frec.azimuth, &d->azimuth[r], sizeof(double));
+      memcpy(frec.zenith, &d->zenith[r], sizeof(double));
+
+      if(verbose == 1) printf("Debug: bin data set  [%02d] [%02d] [%d] [0x%.2x 0x%.2x 0x%.2x 0x%.2x] [%07.3f] [0x%.2x 0x%.2x 0x%.2x 0x%.2x] [%07.3f]\n",
+                            frec.hour, frec.minute, frec.dflag,
+                            frec.azimuth[0], frec.azimuth[1], frec.azimuth[2], frec.azimuth[3],
+                            d->azimuth[r],
+                            frec.zenith[0], frec.zenith[1], frec.zenith[2], frec.zenith[3],
+                            d->zenith[r]);
+
+      /* -------------------------------------------------------- *
+       * write the byte array struct to the bin file w/o newline  *
+       * in aligned files, pad up to the next block first         *
+       * -------------------------------------------------------- */
+      pos = write_padding(fdayb, pos, sunread_record_offset(i, hsize, blockalign));
+      fwrite(&frec, sizeof(frec), 1, fdayb);
+      pos += sizeof(frec);
+   }
+   if(blockalign && pos % blockalign) write_padding(fdayb, pos, pos + blockalign - pos % blockalign);
+   awrite_close(fdayc);
+   awrite_close(fdayb);
+
+   if(tolerance > 0) write_dayindex(d, keep, num);
+}
+
+/* ----------------------------------------------------------- *
+ * write_srsslot() writes the record into its day-of-year slot *
+ * of srs-yyyy.bin. A new file is created with 366 zero slots. *
+ * pwrite() puts each record in place with one call, so slots  *
+ * can be filled in any order, and by more than one writer.    *
+ * ----------------------------------------------------------- */
+void write_srsslot(const char *fpath, const struct drecord *srs, int yday) {
+   struct stat st = {0};
+   int fd;
+
+   if (stat(fpath, &st) == -1) printf("Create srs bin file [%s]\n", fpath);
+   else printf("Update srs bin file [%s]\n", fpath);
+   if((fd = open(fpath, O_WRONLY | O_CREAT, 0644)) < 0) {
+      printf("Error open %s for writing\n", fpath);
+      exit(-1);
    }
-}
-/* ------------------------------------------------------------ *
- * write_dsetfile() create the dataset description file         *
- * ------------------------------------------------------------ */
-void write_dsetfile(spa_data spa, int num) {
-   FILE *dset;
-   char fpath[1024];
-   snprintf(fpath, sizeof(fpath), "%s/%s", outdir, dsetfile);
-   if(! (dset=fopen(fpath, "w"))) {
-      printf("Error open %s for writing.\n", fpath);
+   if(ftruncate(fd, SRSSLOTS * sizeof(*srs)) != 0 ||
+      pwrite(fd, srs, sizeof(*srs), yday * sizeof(*srs)) != sizeof(*srs)) {
+      printf("Error write %s slot %d\n", fpath, yday);
       exit(-1);
    }
-   else printf("Create dataset file [%s]\n", fpath);
-
-   fprintf(dset, "prgversion: %s\n", progver);
-   fprintf(dset, "prgrundate: %s\n", rundate);
-   fprintf(dset, "start-date: %d%02d%02d\n", spa.year, spa.month, spa.day);
-   fprintf(dset, "locationlg: %f\n", spa.longitude);
-   fprintf(dset, "locationla: %f\n", spa.latitude);
-   fprintf(dset, "locationtz: %f\n", spa.timezone);
-   fprintf(dset, "mag-declin: %f\n", mdeclination);
-   fprintf(dset, "dayfiles-#: %d\n", num);
-   fprintf(dset, "daybinsize: %ld Bytes\n", sizeof(struct brecord));
-   fprintf(dset, "srsbinsize: %ld Bytes\n", sizeof(struct drecord));
-   fclose(dset);
+   close(fd);
 }
 
 /* ----------------------------------------------------------- *
- * srsazimut() calculates the azimuth values at sunrise sunset *
+ * write_srsfiles() adds one record to the yearly srs-yyyy.bin *
+ * and srs-yyyy.csv files, creating them on the years 1st day. *
  * ----------------------------------------------------------- */
-uint16_t srsazimuth(spa_data spa, struct tm srs_tm) {
-   int result = 0;
-   uint16_t azimuth = 0;
+void write_srsfiles(const struct drecord *srs, int year, int yday) {
+   FILE *fsrsb = NULL, *fsrsc;
+   char fpath[1024];
+
    /* -------------------------------------------------------- *
-    * copy the original spa structure to local copy called srs *
+    * Do we have a yearly sunrise/sunset file srs-yyyy.bin ?   *
     * -------------------------------------------------------- */
-   spa_data srs = spa;
+   snprintf(srsbfile, sizeof(srsbfile), "srs-%04d.bin", year);
+   if(verbose == 1) printf("Debug: srsb file name  [%s]\n", srsbfile);
+   snprintf(fpath, sizeof(fpath), "%s/%s", outdir, srsbfile);
+
+   struct stat st = {0};
+   if(srsslots) write_srsslot(fpath, srs, yday);
+   else if (stat(fpath, &st) == -1) {      // if we dont have the file, create
+      if(! (fsrsb=fopen(fpath, "w"))) {
+         printf("Error open %s for writing\n", fpath);
+         exit(-1);
+      } 
+     printf("Create srs bin file [%s]\n", fpath);
+   }
+   else {                             // if we have the file, append to it
+      if(! (fsrsb=fopen(fpath, "a"))) {
+         printf("Error open %s for appending\n", fpath);
+         exit(-1);
+      } 
+     printf("Update srs bin file [%s]\n", fpath);
+   }
    /* -------------------------------------------------------- *
-    * set the sunrise/sunset time for spa calculation          *
+    * Do we have a yearly sunrise/sunset file srs-yyyy.csv ?   *
     * -------------------------------------------------------- */
-   srs.hour   = srs_tm.tm_hour;
-   srs.minute = srs_tm.tm_min;
-   srs.second = srs_tm.tm_sec;
-  /* -------------------------------------------------------- *
-   * call the calculation function and pass the SPA structure *
-   * -------------------------------------------------------- */
-   result = spa_calculate(&srs);
-   if(result > 0) handle_spa_errors(srs, result);
-  /* -------------------------------------------------------- *
-   * round the double value of azimuth to full degrees        *
-   * -------------------------------------------------------- */
-   azimuth = (uint16_t) round(srs.azimuth);
-   return azimuth;
-}
-
-/* ----------------------------------------------------------- *
- * transelevation() calculates the day's max elevation angle   *
- * ----------------------------------------------------------- */
-int16_t transelevation(spa_data spa, struct tm transit_tm) {
-   int result = 0;
-   int16_t zenith = 0;
-   int16_t elevation = 0;
+   snprintf(srscfile, sizeof(srscfile), "srs-%04d.csv", year);
+   if(verbose == 1) printf("Debug: srsc file name  [%s]\n", srscfile);
+   snprintf(fpath, sizeof(fpath), "%s/%s", outdir, srscfile);
+
+   if (stat(fpath, &st) == -1) {      // if we dont have the file, create
+      if(! (fsrsc=fopen(fpath, "w"))) {
+         printf("Error open %s for writing\n", fpath);
+         exit(-1);
+      } 
+     printf("Create srs csv file [%s]\n", fpath);
+   }
+   else {                             // if we have the file, append to it
+      if(! (fsrsc=fopen(fpath, "a"))) {
+         printf("Error open %s for appending\n", fpath);
+         exit(-1);
+      } 
+     printf("Update srs csv file [%s]\n", fpath);
+   }
+
    /* -------------------------------------------------------- *
-    * copy the original spa structure to local copy transit    *
+    * add record to the sunrise/sunset csv file srsyyyy.csv    *
     * -------------------------------------------------------- */
-   spa_data transit = spa;
+   fprintf(fsrsc, "%04d-%02d-%02d,%02d:%02d,%d,%02d:%02d,%d,%02d:%02d,%d\n",
+        year, srs->month, srs->day, 
+        srs->risehour, srs->riseminute, srs->riseazimuth,
+        srs->transithour, srs->transitminute, srs->transitelevation,
+        srs->sethour, srs->setminute, srs->setazimuth);
+   fclose(fsrsc);
 
    /* -------------------------------------------------------- *
-    * set the sunrise/sunset time for spa calculation          *
+    * add record to the sunrise/sunset binary file srsyyyy.bin *
     * -------------------------------------------------------- */
-   transit.hour   = transit_tm.tm_hour;
-   transit.minute = transit_tm.tm_min;
-   transit.second = transit_tm.tm_sec;
-  /* -------------------------------------------------------- *
-   * call the calculation function and pass the SPA structure *
-   * -------------------------------------------------------- */
-   result = spa_calculate(&transit);
-   if(result > 0) handle_spa_errors(transit, result);
-  /* -------------------------------------------------------- *
-   * round the double value of azimuth to full degrees        *
-   * -------------------------------------------------------- */
-   zenith = (int16_t) round(transit.zenith);
-  /* -------------------------------------------------------- *
-   * Because the spa algorithm returns the zenith distance we *
-   * convert it into elevation. elevation + z-distance = 90   *
-   * For nighttime, the elevation becomes negative, but here  *
-   * we only use it for transit time peak value (solar noon). *
-   * -------------------------------------------------------- */
-   elevation = 90 - zenith;
-   return elevation;
+   if(fsrsb) {
+      fwrite(srs, sizeof(*srs), 1, fsrsb);
+      fclose(fsrsb);
+   }
+}
+
+/* ----------------------------------------------------------- *
+ * sink_srs(), sink_day() and sink_spaerror() are the generator *
+ * sink writing the data files                                 *
+ * ----------------------------------------------------------- */
+int sink_srs(void *ctx, const struct drecord *srs, int year, int yday) {
+   if(checkpoints && time(NULL) - lastckpt >= CKPTSECS) write_checkpoint(year, srs->month, srs->day);
+   if(streamfd < 0) write_srsfiles(srs, year, yday);
+   if(strcmp(format, "progmem") == 0) progmem_srs(srs);
+#ifdef HAVE_SQLITE
+   if(db) sql_srs(srs, year);
+#endif
+   return 0;
+}
+
+int sink_day(void *ctx, const struct dayset *d) {
+   write_dayfiles(d);
+   return 0;
+}
+
+void sink_spaerror(void *ctx, const spa_data *spa, int errcode) {
+   handle_spa_errors(*spa, errcode);
+}
+
+/* ----------------------------------------------------------- *
+ * sink_want() links the day files from the --cachedir cache   *
+ * if it has all of them, then the day is not calculated.      *
+ * Otherwise the files the day gets are noted for the cache.   *
+ * ----------------------------------------------------------- */
+int sink_want(void *ctx, int year, int month, int day) {
+   static const char *binexts[] = { "csv", "bin" };
+   static const char *colexts[] = { "az", "ze", "df", "csv" };
+   const char **ext = columns ? colexts : binexts;
+   int i, n = columns ? 4 : 2;
+   char date[16], fpath[1024];
+
+   if(!daycacheon) return 1;
+   snprintf(date, sizeof(date), "%04d%02d%02d", year, month, day);
+   for(i = 0; i < n && daycache_has(date, ext[i]); i++);
+   if(i == n) {
+      for(i = 0; i < n; i++) {
+         datefile_path(fpath, sizeof(fpath), year, month, day, ext[i]);
+         if(daycache_link(date, ext[i], fpath) != 0) exit(-1);
+         printf("Link day %s file [%s]\n", ext[i], fpath);
+      }
+      cachehits++;
+      return 0;
+   }
+   for(i = 0; i < n; i++) {
+      datefile_path(fpath, sizeof(fpath), year, month, day, ext[i]);
+      daycache_add(date, ext[i], fpath);
+   }
+   cachemisses++;
+   return 1;
+}
+
+/* ----------------------------------------------------------- *
+ * at_position() prints the sun position for --at, with one    *
+ * SPA call and without touching the filesystem                *
+ * ----------------------------------------------------------- */
+int at_position() {
+   struct sunconf conf = { longitude, latitude, tz, interval, 0, 0, verbose };
+   struct sunpos pos;
+   struct tm at_tm;
+   time_t t;
+   int result;
+
+   if(strcmp(attime, "now") == 0) t = time(NULL);
+   else {
+      memset(&at_tm, 0, sizeof(at_tm));
+      sscanf(attime, "%d-%d-%dT%d:%d:%d", &at_tm.tm_year, &at_tm.tm_mon, &at_tm.tm_mday,
+             &at_tm.tm_hour, &at_tm.tm_min, &at_tm.tm_sec);
+      at_tm.tm_year -= 1900;
+      at_tm.tm_mon -= 1;
+      at_tm.tm_isdst = -1;
+      t = mktime(&at_tm);
+   }
+   localtime_r(&t, &at_tm);
+
+   if((result = sun_position(&conf, t, &pos)) > 0) {
+      printf("Error: SPA error code %d for --at %s\n", result, attime);
+      return -1;
+   }
+   printf("%04d-%02d-%02dT%02d:%02d:%02d,%d,%.3f,%.3f,%.3f\n",
+          at_tm.tm_year + 1900, at_tm.tm_mon + 1, at_tm.tm_mday, at_tm.tm_hour, at_tm.tm_min, at_tm.tm_sec,
+          pos.dflag, pos.azimuth, pos.zenith, pos.elevation);
+   return 0;
 }
 
 /* ----------------------------------------------------------- *
  * parseargs() checks the commandline arguments with C getopt  *
  * ----------------------------------------------------------- */
 void parseargs(int argc, char* argv[]) {
+   static struct option longopts[] = {
+      { "serve", required_argument, NULL, 'S' },
+      { "http",  required_argument, NULL, 'H' },
+      { "cache", required_argument, NULL, 'C' },
+      { "at",    required_argument, NULL, 'A' },
+      { "filter", required_argument, NULL, 'F' },
+      { "cachedir", required_argument, NULL, 'K' },
+      { "resume", no_argument, NULL, 'R' },
+      { "stream", required_argument, NULL, 'T' },
+      { NULL, 0, NULL, 0 }
+   };
    int arg;
    opterr = 0;
 
@@ -320,7 +1927,7 @@ void parseargs(int argc, char* argv[]) {
        printf("See ./suncalc -h for further usage.\n");
    }
 
-   while ((arg = (int) getopt (argc, argv, "x:y:t:i:p:o:hv")) != -1) {
+   while ((arg = (int) getopt_long (argc, argv, "x:y:t:i:p:o:a:cnlsdbgrq:f:m:w:hv", longopts, NULL)) != -1) {
       switch (arg) {
          // arg -v verbose, type: flag, optional
          case 'v':
@@ -383,6 +1990,81 @@ void parseargs(int argc, char* argv[]) {
             }
             break;
 
+         // arg -a adaptive sampling tolerance type: double
+         case 'a':
+            if(verbose == 1) printf("Debug: arg -a, value %s\n", optarg);
+            tolerance = strtod(optarg, NULL);
+            if(tolerance < 0.01 || tolerance > 10) {
+               printf("Error: Cannot get valid tolerance.\n");
+               exit(-1);
+            }
+            break;
+
+         // arg -c Chebyshev coefficient day files, type: flag
+         case 'c':
+            chebyshev = 1; break;
+
+         // arg -n daylight day files, type: flag
+         case 'n':
+            daylight = 1; break;
+
+         // arg -l column day files, type: flag
+         case 'l':
+            columns = 1; break;
+
+         // arg -s srs files with day-of-year slots, type: flag
+         case 's':
+            srsslots = 1; break;
+
+         // arg -d yyyy/mm day file folders, type: flag
+         case 'd':
+            dirtree = 1; break;
+
+         // arg -b SD sector aligned day records, type: flag
+         case 'b':
+            blockalign = 512; break;
+
+         // arg -g compressed archive file, type: flag
+         case 'g':
+            archive = 1; break;
+
+         // arg -r year-over-year residual day files, type: flag
+         case 'r':
+            residual = 1; break;
+
+         // arg -q SQLite database file, type: string
+         case 'q':
+#ifndef HAVE_SQLITE
+            printf("Error: option -q needs SQLite, build suncalc with 'make SQLITE=1'.\n");
+            exit(-1);
+#endif
+            snprintf(dbfile, sizeof(dbfile), "%s", optarg);
+            break;
+
+         // arg -f additional output format, type: string
+         case 'f':
+            if(verbose == 1) printf("Debug: arg -f, value %s\n", optarg);
+            if(strcmp(optarg, "npy") == 0 || strcmp(optarg, "progmem") == 0 || strcmp(optarg, "bin") == 0 ||
+               strcmp(optarg, "csv") == 0 || strcmp(optarg, "json") == 0) {
+               strncpy(format, optarg, sizeof(format) - 1);
+            }
+            else {
+               printf("Error: invalid output format %s.\n", optarg);
+               usage();
+               exit(-1);
+            }
+            break;
+
+         // arg -m flash budget type: long
+         case 'm':
+            if(verbose == 1) printf("Debug: arg -m, value %s\n", optarg);
+            flashlimit = atol(optarg);
+            if(flashlimit < 1024) {
+               printf("Error: Cannot get valid flash budget.\n");
+               exit(-1);
+            }
+            break;
+
          // arg -o output directory
          // writes the data files in that folder. example: ./tracker-data
          case 'o':
@@ -390,6 +2072,77 @@ void parseargs(int argc, char* argv[]) {
             strncpy(outdir, optarg, sizeof(outdir));
             break;
 
+         // arg -w day file writer backend, type: string
+         case 'w':
+            if(strcmp(optarg, "stdio") == 0) writer = AWRITE_STDIO;
+            else if(strcmp(optarg, "threads") == 0) writer = AWRITE_THREADS;
+            else if(strcmp(optarg, "uring") == 0) writer = AWRITE_URING;
+            else {
+               printf("Error: Cannot get valid writer stdio, threads or uring.\n");
+               exit(-1);
+            }
+            break;
+
+         // arg --serve position service socket, type: string
+         case 'S':
+            snprintf(serveon, sizeof(serveon), "%s", optarg);
+            break;
+
+         // arg --http service port type: int
+         case 'H':
+            httpport = atoi(optarg);
+            if(httpport < 1 || httpport > 65535) {
+               printf("Error: Cannot get valid http port.\n");
+               exit(-1);
+            }
+            break;
+
+         // arg --cache service day tables type: int
+         case 'C':
+            cachedays = atoi(optarg);
+            if(cachedays < 1 || cachedays > 100000) {
+               printf("Error: Cannot get valid cache size.\n");
+               exit(-1);
+            }
+            break;
+
+         // arg --at point query time, type: string
+         case 'A': {
+            int y, mo, d, h, mi, sec;
+            if(strcmp(optarg, "now") != 0 &&
+               (sscanf(optarg, "%d-%d-%dT%d:%d:%d", &y, &mo, &d, &h, &mi, &sec) != 6 ||
+                mo < 1 || mo > 12 || d < 1 || d > 31 || h < 0 || h > 23 || mi < 0 || mi > 59 || sec < 0 || sec > 59)) {
+               printf("Error: Cannot get valid time yyyy-mm-ddThh:mm:ss for --at.\n");
+               exit(-1);
+            }
+            snprintf(attime, sizeof(attime), "%s", optarg);
+            break;
+         }
+
+         // arg --filter stdin timestamp format, type: string
+         case 'F':
+            if(strcmp(optarg, "text") != 0 && strcmp(optarg, "bin") != 0) {
+               printf("Error: Cannot get valid filter input text or bin.\n");
+               exit(-1);
+            }
+            snprintf(filtermode, sizeof(filtermode), "%s", optarg);
+            break;
+
+         // arg --cachedir day file cache folder, type: string
+         case 'K':
+            snprintf(daycachedir, sizeof(daycachedir), "%s", optarg);
+            break;
+
+         // arg --resume continue an unfinished dataset, type: flag
+         case 'R':
+            resume = 1;
+            break;
+
+         // arg --stream serial device, type: string
+         case 'T':
+            snprintf(streamdev, sizeof(streamdev), "%s", optarg);
+            break;
+
          // arg -h usage, type: flag, optional
          case 'h':
             usage(); exit(0);
@@ -410,6 +2163,37 @@ void parseargs(int argc, char* argv[]) {
             break;
       }
    }
+
+   /* ----------------------------------------------------------- *
+    * the day file layouts exclude each other                     *
+    * ----------------------------------------------------------- */
+   if((chebyshev > 0) + (tolerance > 0) + (daylight > 0) + (residual > 0) + (columns > 0) > 1) {
+      printf("Error: options -a, -c, -n, -l and -r cannot be combined.\n");
+      exit(-1);
+   }
+   if(residual && strcmp(period, "2y") != 0 && strcmp(period, "tf") != 0) {
+      printf("Error: option -r needs a multi-year period -p 2y or tf.\n");
+      exit(-1);
+   }
+
+   /* ----------------------------------------------------------- *
+    * streaming to stdout uses its own record formats             *
+    * ----------------------------------------------------------- */
+   if(strcmp(outdir, "-") == 0) {
+      if(chebyshev || archive || residual || columns || strcmp(format, "npy") == 0 || strcmp(format, "progmem") == 0) {
+         printf("Error: options -c, -g, -l, -r, -f npy and -f progmem cannot stream to stdout.\n");
+         exit(-1);
+      }
+      if(strlen(format) == 0) strcpy(format, "bin");
+   }
+   else if(strlen(format) > 0 && strcmp(format, "npy") != 0 && strcmp(format, "progmem") != 0) {
+      printf("Error: output format %s needs -o - for stdout.\n", format);
+      exit(-1);
+   }
+   if(blockalign && (chebyshev || columns || strcmp(outdir, "-") == 0)) {
+      printf("Error: option -b cannot be combined with -c, -l or -o -.\n");
+      exit(-1);
+   }
 }
 
 /* ------------------------------------------------------------ *
@@ -422,91 +2206,46 @@ int main(int argc, char *argv[]) {
     * process the cmdline parameters                             *
     * ---------------------------------------------------------- */
    parseargs(argc, argv);
+   if(strlen(serveon) > 0) return serve_run(serveon, httpport, cachedays, verbose);
+   if(strlen(attime) > 0) return at_position();
+   if(strlen(filtermode) > 0) {
+      struct sunconf conf = { longitude, latitude, tz, interval, 0, 0, verbose };
+      return filter_run(filtermode, &conf);
+   }
+   if(strlen(streamdev) > 0) {
+      struct sunconf conf = { longitude, latitude, tz, interval, 0, 0, verbose };
+      return serial_run(streamdev, &conf, verbose);
+   }
+
+   /* ---------------------------------------------------------- *
+    * "-o -" streams the data to stdout: keep the original stdout *
+    * for data only, and send all program messages to stderr.    *
+    * ---------------------------------------------------------- */
+   if(strcmp(outdir, "-") == 0) {
+      signal(SIGPIPE, SIG_IGN);
+      streamfd = dup(STDOUT_FILENO);
+      dup2(STDERR_FILENO, STDOUT_FILENO);
+   }
 
    /* ---------------------------------------------------------- *
     * get current time (now), write program start if verbose     *
     * ---------------------------------------------------------- */
-   time_t tsnow, tstart, tend, tcalc, trise = 0, tset = 0;
+   time_t tsnow, tstart, tend;
    tsnow = time(NULL);
-   struct tm *now, start_tm, end_tm, calc_tm, rise_tm, transit_tm, set_tm;
+   struct tm *now, start_tm, end_tm;
    now = localtime(&tsnow);
    strftime(rundate, sizeof(rundate), "%a %Y-%m-%d", now);
    if(verbose == 1) printf("Debug: ts [%lld][%s]\n", (long long) tsnow, rundate);
 
    /* ----------------------------------------------------------- *
-    * always run over a full day: start 00:00:00 end 00:00:00 +1d *
-    * ----------------------------------------------------------- */
-   start_tm = *now;      // initialize start date with current date
-   end_tm = *now;        // initialize end date with current date
-   start_tm.tm_hour = 0;
-   start_tm.tm_min  = 0;
-   start_tm.tm_sec  = 0;
-   end_tm.tm_hour = 0;
-   end_tm.tm_min  = 0;
-   end_tm.tm_sec  = 0;
-
-   /* ----------------------------------------------------------- *
-    * "-p" set the dataset period to calculate                    *
+    * "-p" set the dataset period to calculate, always full days  *
     * ----------------------------------------------------------- */
-   if(strlen(period) > 0) {
-      if(strcmp(period, "nd") == 0) {      // tomorrow
-         start_tm.tm_mday += 1;
-         end_tm.tm_mday += 2;
-      }
-      else if(strcmp(period, "nm") == 0) { // next month
-         start_tm.tm_mon += 1;             // count 1 month forward
-         start_tm.tm_mday = 1;             // set start day to 1st
-         end_tm.tm_mon += 2;               // count 2 months forward
-         end_tm.tm_mday = 1;               // set end day to 1st
-      }
-      else if(strcmp(period, "nq") == 0) { // next quarter
-      } 
-      else if(strcmp(period, "ny") == 0) { // next year
-         start_tm.tm_year += 1;            // count year forward
-         start_tm.tm_mon   = 0;            // set month to Jan
-         start_tm.tm_mday  = 1;            // set day to 1st
-         end_tm.tm_year += 2;              // count 2 years forward
-         end_tm.tm_mon   = 0;              // set month to Jan
-         end_tm.tm_mday  = 1;              // set day to 1st
-      }
-      else if(strcmp(period, "td") == 0) { // this month
-         end_tm.tm_mday += 1;
-      }
-      else if(strcmp(period, "tm") == 0) { // this month
-         start_tm.tm_mday = 1;             // set start day to 1st
-         end_tm.tm_mon += 1;               // count 1 month forward
-         end_tm.tm_mday = 1;               // set end day to 1st
-      }
-      else if(strcmp(period, "tq") == 0) { // this quarter
-      } 
-      else if(strcmp(period, "ty") == 0) { // this year
-         start_tm.tm_mon   = 0;            // set month to Jan
-         start_tm.tm_mday  = 1;            // set start day to 1st
-         end_tm.tm_year += 1;              // count 1 year forward
-         end_tm.tm_mon   = 0;              // set month to Jan
-         end_tm.tm_mday  = 1;              // set day to 1st
-      }
-      else if(strcmp(period, "2y") == 0) { // this year + next year
-         start_tm.tm_mon   = 0;            // set month to Jan
-         start_tm.tm_mday  = 1;            // set start day to 1st
-         end_tm.tm_year += 2;              // count 2 years forward
-         end_tm.tm_mon   = 0;              // set month to Jan
-         end_tm.tm_mday  = 1;              // set day to 1st
-      }
-      else if(strcmp(period, "tf") == 0) { // this year + next year
-         start_tm.tm_mon   = 0;            // set month to Jan
-         start_tm.tm_mday  = 1;            // set start day to 1st
-         end_tm.tm_year += 10;             // count 10 years forward
-         end_tm.tm_mon   = 0;              // set month to Jan
-         end_tm.tm_mday  = 1;              // set day to 1st
-      }
-      else {
-         printf("Error: invalid dataset period %s.\n", period);
-         exit(-1);
-      }
+   if(sun_period(period, tsnow, &tstart, &tend) != 0) {
+      printf("Error: invalid dataset period %s.\n", period);
+      exit(-1);
    }
-   tstart = mktime(&start_tm);
-   tend = mktime(&end_tm);
+   start_tm = *localtime(&tstart);
+   end_tm = *localtime(&tend);
    if(verbose == 1) printf("Debug: Data set start [%d-%02d-%02d %02d:%02d:%02d]\n",
                             start_tm.tm_year + 1900, start_tm.tm_mon + 1, start_tm.tm_mday,
                             start_tm.tm_hour, start_tm.tm_min, start_tm.tm_sec);
@@ -515,300 +2254,171 @@ int main(int argc, char *argv[]) {
                             end_tm.tm_hour, end_tm.tm_min, end_tm.tm_sec);
 
    /* -------------------------------------------------------- *
-    * open target folder, create if it does not exist          *
+    * a dataset of day files gets checkpoints, outputs that    *
+    * keep the whole period in memory or in one stream cannot  *
+    * continue from one                                        *
+    * -------------------------------------------------------- */
+   char fpath[1024];
+   time_t tresume = 0;
+   dayfile_params(fpath, sizeof(fpath));
+   snprintf(runparams, sizeof(runparams), "%s tolerance=%f chebyshev=%d dirtree=%d srsslots=%d",
+            fpath, tolerance, chebyshev, dirtree, srsslots);
+   periodstart = tstart;
+   periodend = tend;
+   checkpoints = !(residual || archive || streamfd >= 0 || strlen(dbfile) > 0 ||
+                   strcmp(format, "npy") == 0 || strcmp(format, "progmem") == 0);
+   if(resume && ! checkpoints) {
+      printf("Error: --resume cannot be combined with -r, -g, -q, -f npy|progmem or -o -.\n");
+      exit(-1);
+   }
+
+   /* -------------------------------------------------------- *
+    * the dataset is written into the staging folder beside    *
+    * the output folder, and replaces it when it is complete.  *
+    * A staging folder of an interrupted run is resumed, or    *
+    * discarded. The old dataset stays readable until then.    *
     * -------------------------------------------------------- */
    struct stat st = {0};
-   if (stat(outdir, &st) == -1) {
-      mkdir(outdir, 0700);
-      printf("Created new output folder [%s]\n", outdir);
+   if(streamfd >= 0) {
+      if(verbose == 1) printf("Debug: Streaming day records to stdout as [%s]\n", format);
    }
    else {
-      if(verbose == 1) printf("Debug: Found output folder [%s], overwriting data.\n", outdir);
-      remove_data(outdir);
+      snprintf(pubdir, sizeof(pubdir), "%s", outdir);
+      check_pubdir();
+      if(snprintf(outdir, sizeof(outdir), "%s.staging", pubdir) >= (int) sizeof(outdir)) {
+         printf("Error: output folder name %s is too long.\n", pubdir);
+         exit(-1);
+      }
+      snprintf(fpath, sizeof(fpath), "%s/%s", pubdir, dsetfile);
+      if(stat(outdir, &st) == 0 && resume && read_checkpoint(&tresume) == 0) {
+         struct tm resume_tm = *localtime(&tresume);
+         printf("Resume dataset [%s] at %d-%02d-%02d\n", outdir,
+                resume_tm.tm_year + 1900, resume_tm.tm_mon + 1, resume_tm.tm_mday);
+      }
+      else if(resume && stat(outdir, &st) != 0 && dset_complete(fpath)) {
+         printf("Dataset [%s] is complete, nothing to resume.\n", pubdir);
+         return 0;
+      }
+      else {
+         if(resume && stat(outdir, &st) != 0 && stat(fpath, &st) == 0)
+            printf("Dataset [%s] is from other options or period, creating it again.\n", pubdir);
+         if(stat(outdir, &st) == 0) {
+            if(verbose == 1) printf("Debug: Found staging folder [%s], discarding it.\n", outdir);
+            discard_data(outdir);
+         }
+         if(mkdir(outdir, 0700) != 0) {
+            printf("Error create folder %s\n", outdir);
+            exit(-1);
+         }
+         printf("Created new output folder [%s]\n", outdir);
+      }
    }
 
    /* -------------------------------------------------------- *
-    * configure the calculation values                         *
-    * some hardcoded values: elevation, pressure, temperature, *
-    * slope, atmospheric refraction, delta_t                   *
+    * set up the generator, with the data files as its sink    *
     * -------------------------------------------------------- */
-   spa_data spa;  //declare the SPA structure
-   spa.year          = (int) start_tm.tm_year+1900;
-   spa.month         = start_tm.tm_mon+1;
-   spa.day           = start_tm.tm_mday;
-   spa.hour          = 0;
-   spa.minute        = 0;
-   spa.second        = 0;
-   spa.timezone      = tz;  // - for trailing GMT, e.g. US, + for ahead of GMT, e.g. Japan
-   spa.delta_ut1     = DELTA_UT1;
-   spa.delta_t       = DELTA_T;
-   spa.longitude     = longitude;
-   spa.latitude      = latitude;
-   spa.elevation     = ELEVATION;
-   spa.pressure      = PRESSURE;
-   spa.temperature   = TEMPERATURE;
-   spa.slope         = SLOPE;
-   spa.azm_rotation  = AZM_ROTATION;
-   spa.atmos_refract = ATM_REFRACT;
-   spa.function      = SPA_ALL;
-   //if(verbose == 1) debug_spa_input(spa);
+   static struct sungen gen;
+   struct sunconf conf = { longitude, latitude, tz, interval, tstart, tend, verbose };
+   struct sunsink files = { NULL, sink_srs, sink_day, sink_spaerror, sink_want };
+   if(sungen_init(&gen, &conf) != 0) {
+      printf("Error: Cannot get valid interval.\n");
+      exit(-1);
+   }
+   int days = gen.days;
+   spa_data spastart = gen.spastart;
+   if(tresume > 0) {
+      conf.start = tresume;
+      sungen_init(&gen, &conf);
+   }
 
    /* -------------------------------------------------------- *
-    * calculate datefile count and write dataset info file     *
+    * cycle through the calculation period                     *
     * -------------------------------------------------------- */
-   tcalc = tstart;
-   int days = difftime(tend,tstart) / 86400;
-   int rows = 86400 / interval;
-   if(verbose == 1) printf("Debug: data days/rows [%d/%d]\n", days, rows);
-   write_dsetfile(spa, days);
-
+   if(strcmp(format, "npy") == 0) npy_open();
+   if(archive) archive_open();
+#ifdef HAVE_SQLITE
+   if(strlen(dbfile) > 0) sql_open(tstart, tend, (long) days * (86400 / interval));
+#endif
    /* -------------------------------------------------------- *
-    * cycle through the calculation period                     *
+    * the day file cache key has all inputs of a day file but  *
+    * its date. Outputs that need every day's positions, or    *
+    * summarize the period, turn the cache off.                *
     * -------------------------------------------------------- */
-   FILE *fdayc = NULL;
-   FILE *fdayb = NULL;
-   FILE *fsrsb = NULL;
-   FILE *fsrsc = NULL;
-   char fpath[1024];
-   int dayflag = 0;
-
-   while(tcalc < tend) {
-      /* -------------------------------------------------------- *
-       * assign the date and time, calculate the solar position   *
-       * -------------------------------------------------------- */
-      calc_tm    = *localtime(&tcalc);
-      spa.year   = (int) calc_tm.tm_year+1900;
-      spa.month  = calc_tm.tm_mon+1;
-      spa.day    = calc_tm.tm_mday;
-      spa.hour   = calc_tm.tm_hour;
-      spa.minute = calc_tm.tm_min;
-      spa.second = calc_tm.tm_sec;
-      /* -------------------------------------------------------- *
-       * call the calculation function and pass the SPA structure *
-       * -------------------------------------------------------- */
-      result = spa_calculate(&spa);
-      if(result > 0) handle_spa_errors(spa, result);
-      /* -------------------------------------------------------- *
-       * check if we got a new day to process                     *
-       * -------------------------------------------------------- */
-      if( calc_tm.tm_hour == 0 && calc_tm.tm_min == 0){
-         /* -------------------------------------------------------- *
-          * if previous data file are still open, close them first   *
-          * -------------------------------------------------------- */
-         if(fdayc) fclose(fdayc);
-         if(fdayb) fclose(fdayb);
-         if(fsrsb) fclose(fsrsb);
-         /* -------------------------------------------------------- *
-          * assign the days sunrise, suntransit and sunset time      *
-          * -------------------------------------------------------- */
-         float min, sec;
-         min = 60.0*(spa.sunrise - (int)(spa.sunrise));
-         sec = 60.0*(min - (int)min);
-         rise_tm = calc_tm;
-         rise_tm.tm_hour = (int)(spa.sunrise);
-         rise_tm.tm_min = (int)min;
-         rise_tm.tm_sec = (int)sec;
-
-         min = 60.0*(spa.suntransit - (int)(spa.suntransit));
-         sec = 60.0*(min - (int)min);
-         transit_tm = calc_tm;
-         transit_tm.tm_hour = (int)(spa.suntransit);
-         transit_tm.tm_min = (int)min;
-         transit_tm.tm_sec = (int)sec;
-
-         min = 60.0*(spa.sunset - (int)(spa.sunset));
-         sec = 60.0*(min - (int)min);
-         set_tm = calc_tm;
-         set_tm.tm_hour = (int)(spa.sunset);
-         set_tm.tm_min = (int)min;
-         set_tm.tm_sec = (int)sec;
-         if(verbose == 1) printf("Debug: sunrise sunset [%02d:%02d:%02d] [%02d:%02d:%02d]\n",
-                                  rise_tm.tm_hour, rise_tm.tm_min, rise_tm.tm_sec,
-                                  set_tm.tm_hour, set_tm.tm_min, set_tm.tm_sec);
-         trise = mktime(&rise_tm);
-         tset = mktime(&set_tm);
-
-         /* -------------------------------------------------------- *
-          * Do we have a yearly sunrise/sunset file srs-yyyy.bin ?   *
-          * -------------------------------------------------------- */
-         snprintf(srsbfile, sizeof(srsbfile), "srs-%04d.bin", calc_tm.tm_year + 1900);
-         if(verbose == 1) printf("Debug: srsb file name  [%s]\n", srsbfile);
-         snprintf(fpath, sizeof(fpath), "%s/%s", outdir, srsbfile);
-
-         struct stat st = {0};
-         if (stat(fpath, &st) == -1) {      // if we dont have the file, create
-            if(! (fsrsb=fopen(fpath, "w"))) {
-               printf("Error open %s for writing\n", fpath);
-               exit(-1);
-            } 
-           printf("Create srs bin file [%s]\n", fpath);
-         }
-         else {                             // if we have the file, append to it
-            if(! (fsrsb=fopen(fpath, "a"))) {
-               printf("Error open %s for appending\n", fpath);
-               exit(-1);
-            } 
-           printf("Update srs bin file [%s]\n", fpath);
-         }
-         /* -------------------------------------------------------- *
-          * Do we have a yearly sunrise/sunset file srs-yyyy.csv ?   *
-          * -------------------------------------------------------- */
-         snprintf(srscfile, sizeof(srscfile), "srs-%04d.csv", calc_tm.tm_year + 1900);
-         if(verbose == 1) printf("Debug: srsc file name  [%s]\n", srscfile);
-         snprintf(fpath, sizeof(fpath), "%s/%s", outdir, srscfile);
-
-         if (stat(fpath, &st) == -1) {      // if we dont have the file, create
-            if(! (fsrsc=fopen(fpath, "w"))) {
-               printf("Error open %s for writing\n", fpath);
-               exit(-1);
-            } 
-           printf("Create srs csv file [%s]\n", fpath);
-         }
-         else {                             // if we have the file, append to it
-            if(! (fsrsc=fopen(fpath, "a"))) {
-               printf("Error open %s for appending\n", fpath);
-               exit(-1);
-            } 
-           printf("Update srs csv file [%s]\n", fpath);
-         }
-         /* -------------------------------------------------------- *
-          * Get sunrise and sunset azimuth values for the new day    *
-          * -------------------------------------------------------- */
-         uint16_t razi = 0;
-         uint16_t sazi = 0;
-         razi = srsazimuth(spa, rise_tm);
-         sazi = srsazimuth(spa, set_tm);
-         if(verbose == 1) printf("Debug: sunrise/sunset [%d - %d] azimuth range [%d] \n", razi, sazi, sazi-razi);
-
-         /* -------------------------------------------------------- *
-          * Get zenith max elevation angle at sun transit (noon)time *
-          * -------------------------------------------------------- */
-         int16_t tele = 0;
-         tele = transelevation(spa, transit_tm);
-         if(verbose == 1) printf("Debug: suntransit at [%d:%d] elevation [%d] \n",
-                                  transit_tm.tm_hour, transit_tm.tm_min, tele);
-
-         /* -------------------------------------------------------- *
-          * create sunrise/sunset file binary data output structure  *
-          * -------------------------------------------------------- */
-         struct drecord srs;
-         srs.month            = calc_tm.tm_mon+1;
-         srs.day              = calc_tm.tm_mday;
-         srs.risehour         = rise_tm.tm_hour;
-         srs.riseminute       = rise_tm.tm_min;
-         srs.riseazimuth      = razi;
-         srs.transithour      = transit_tm.tm_hour;
-         srs.transitminute    = transit_tm.tm_min;
-         srs.transitelevation = tele;
-         srs.sethour          = set_tm.tm_hour;
-         srs.setminute        = set_tm.tm_min;
-         srs.setazimuth       = sazi;
-
-         /* -------------------------------------------------------- *
-          * add record to the sunrise/sunset csv file srsyyyy.csv    *
-          * -------------------------------------------------------- */
-         fprintf(fsrsc, "%04d-%02d-%02d,%02d:%02d,%d,%02d:%02d,%d,%02d:%02d,%d\n",
-              calc_tm.tm_year + 1900, srs.month, srs.day, 
-              srs.risehour, srs.riseminute, srs.riseazimuth,
-              srs.transithour, srs.transitminute, srs.transitelevation,
-              srs.sethour, srs.setminute, srs.setazimuth);
-         fflush(fsrsc);
-
-         /* -------------------------------------------------------- *
-          * add record to the sunrise/sunset binary file srsyyyy.bin *
-          * -------------------------------------------------------- */
-         fwrite(&srs, sizeof(srs), 1, fsrsb);
-         fflush(fsrsb);
-
-         /* -------------------------------------------------------- *
-          * create day csv file yyyymmdd.csv under the outdir folder *
-          * -------------------------------------------------------- */
-         snprintf(daycfile, sizeof(daycfile), "%04d%02d%02d.csv",
-                  calc_tm.tm_year + 1900, calc_tm.tm_mon + 1, calc_tm.tm_mday);
-         if(verbose == 1) printf("Debug: csv file name [%s]\n", daycfile);
-         snprintf(fpath, sizeof(fpath), "%s/%s", outdir, daycfile);
-         /* -------------------------------------------------------- *
-          * open a new csv data file for writing                     *
-          * -------------------------------------------------------- */
-         if(! (fdayc=fopen(fpath, "w"))) {
-            printf("Error open %s for writing\n", fpath);
-            exit(-1);
-         } else printf("Create day csv file [%s]\n", fpath);
- 
-         /* -------------------------------------------------------- *
-          * create the bin file yyyymmdd.bin under the outdir folder *
-          * -------------------------------------------------------- */
-         snprintf(daybfile, sizeof(daybfile), "%04d%02d%02d.bin",
-                  calc_tm.tm_year + 1900, calc_tm.tm_mon + 1, calc_tm.tm_mday);
-         if(verbose == 1) printf("Debug: bin file name [%s]\n", daybfile);
-         snprintf(fpath, sizeof(fpath), "%s/%s", outdir, daybfile);
-         /* -------------------------------------------------------- *
-          * open a new bin data file for writing                     *
-          * -------------------------------------------------------- */
-         if(! (fdayb=fopen(fpath, "w"))) {
-            printf("Error open %s for writing\n", fpath);
-            exit(-1);
-         } else printf("Create day bin file [%s]\n", fpath);
-      } // end of new day processing
-      
-      /* -------------------------------------------------------- *
-       * Create dayflag, needs to occur after sunrise/sunset calc *
-       * -------------------------------------------------------- */
-      if(tcalc >= trise && tcalc <= tset) dayflag = 1;
-      else dayflag = 0;
-      /* -------------------------------------------------------- *
-       * debug calculation output                                 *
-       * -------------------------------------------------------- */
-      if(verbose == 1) printf("Debug: calc data set [%04d-%02d-%02d %02d:%02d:%02d] Z[%07.3f] A[%07.3f] DF[%d]\n",
-                            calc_tm.tm_year + 1900, calc_tm.tm_mon + 1, calc_tm.tm_mday, calc_tm.tm_hour,
-                            calc_tm.tm_min, calc_tm.tm_sec, spa.zenith, spa.azimuth, dayflag);
-      /* -------------------------------------------------------- *
-       * write the result to the data file using this csv format: *
-       * time hh:mm, dayflag night=0, azimuth angle, zenith angle *
-       * -------------------------------------------------------- */
-      fprintf(fdayc, "%02d:%02d,%d,%.3f,%.3f\n",
-              calc_tm.tm_hour, calc_tm.tm_min, dayflag, spa.azimuth, spa.zenith);
-
-      /* -------------------------------------------------------- *
-       * create binary file data output                           *
-       * -------------------------------------------------------- */
-      struct brecord frec;
-      frec.hour     = calc_tm.tm_hour;
-      frec.minute   = calc_tm.tm_min;
-      frec.dflag    = dayflag;
-      memcpy(frec.azimuth,&spa.azimuth,sizeof(spa.azimuth));
-      memcpy(frec.zenith,&spa.zenith,sizeof(spa.zenith));
-
-      /* -------------------------------------------------------- *
-       * debug binary file data output                            *
-       * -------------------------------------------------------- */
-      double azi;
-      memcpy(&azi, frec.azimuth, sizeof(double));
-      double zen;
-      memcpy(&zen, frec.zenith, sizeof(double));
-
-      if(verbose == 1) printf("Debug: bin data set  [%02d] [%02d] [%d] [0x%.2x 0x%.2x 0x%.2x 0x%.2x] [%07.3f] [0x%.2x 0x%.2x 0x%.2x 0x%.2x] [%07.3f]\n",
-                            frec.hour, frec.minute, frec.dflag,
-                            frec.azimuth[0], frec.azimuth[1], frec.azimuth[2], frec.azimuth[3],
-                            azi,
-                            frec.zenith[0], frec.zenith[1], frec.zenith[2], frec.zenith[3],
-                            zen);
-
-      /* -------------------------------------------------------- *
-       * write the byte array struct to the bin file w/o newline  *
-       * -------------------------------------------------------- */
-      fwrite(&frec, sizeof(frec), 1, fdayb);
+   if(strlen(daycachedir) > 0) {
+      char params[1024];
+      dayfile_params(params, sizeof(params));
+      if(tolerance > 0 || chebyshev || residual || archive || streamfd >= 0 || strlen(dbfile) > 0 ||
+         strcmp(format, "npy") == 0 || strcmp(format, "progmem") == 0)
+         printf("Day file cache: not used with -a, -c, -r, -g, -q, -f npy|progmem or -o -\n");
+      else if(daycache_open(daycachedir, params) != 0) {
+         printf("Error: Cannot use cache folder %s.\n", daycachedir);
+         exit(-1);
+      }
+      else daycacheon = 1;
+      if(verbose == 1) printf("Debug: day file cache key [%s]\n", params);
+   }
+   struct pipestats pipe;
+   int wanted = writer;
+   if((writer = awrite_init(writer)) != wanted)
+      printf("Writer %s is not available, using %s\n", awrite_name(wanted), awrite_name(writer));
+   struct timespec wstart, wend;
+   clock_gettime(CLOCK_MONOTONIC, &wstart);
+   lastckpt = time(NULL);
+   result = pipeline_run(&gen, &files, &pipe);
+   if(result != 0) exit(result);
+   if(awrite_finish() != 0) exit(-1);
+   clock_gettime(CLOCK_MONOTONIC, &wend);
+   if(daycacheon && daycache_close() != 0) printf("Day file cache: some new files were not stored\n");
 
-      /* -------------------------------------------------------- *
-       * calculate next time interval                             *
-       * -------------------------------------------------------- */
-      tcalc=tcalc+interval;
+   /* -------------------------------------------------------- *
+    * close the period files, flush the stdout data stream     *
+    * -------------------------------------------------------- */
+   if(strcmp(format, "npy") == 0) npy_close();
+   if(archive && gor_close(&garch) != 0) {
+      printf("Error writing archive index\n");
+      exit(-1);
    }
+   if(streamfd >= 0) stream_flush();
+#ifdef HAVE_SQLITE
+   if(db) sql_close();
+#endif
+
    /* -------------------------------------------------------- *
-    * close the last fdayc and binary files                    *
+    * write the dataset info file last, once all data is done  *
     * -------------------------------------------------------- */
-   if(fdayc) fclose(fdayc);
-   if(fdayb) fclose(fdayb);
-   if(fsrsb) fclose(fsrsb);
+   if(strcmp(format, "progmem") == 0) write_progmem(spastart);
+   if(streamfd < 0) write_dsetfile(spastart, days);
+   if(checkpoints) {
+      snprintf(fpath, sizeof(fpath), "%s/%s", outdir, ckptfile);
+      unlink(fpath);
+   }
+   if(streamfd < 0) publish_data();
+#ifdef HAVE_SQLITE
+   if(strlen(dbfile) > 0)
+      printf("SQLite database: %ld sample rows for site %lld in %s\n", sqlrows, (long long) sqlsite, dbfile);
+#endif
+   if(tolerance > 0)
+      printf("Adaptive sampling: kept %ld of %ld records (%.1f%%), max error %.3f degrees\n",
+             keptrows, allrows, 100.0 * keptrows / allrows, maxerror);
+   if(chebyshev)
+      printf("Chebyshev day files: %d segments, %d coefficients, max error %.3f degrees\n",
+             CHEB_SEGMENTS, CHEB_ORDER, chebmaxerr);
+   if(residual)
+      printf("Residual day files: %ld days in %ld bytes, %ld bytes as bin files\n",
+             resdays, resbytes, resdays * (86400 / interval) * (long) sizeof(struct brecord));
+   if(archive)
+      printf("Archive: %ld record bytes compressed to %ld bytes (%.1f:1)\n",
+             archraw, archbytes, (double) archraw / archbytes);
+   if(daycacheon)
+      printf("Day file cache: %ld of %ld days from the cache (%.1f%%), %ld files %ld bytes saved, %ld of them copied, %ld new files stored\n",
+             cachehits, cachehits + cachemisses, cachehits + cachemisses > 0 ? 100.0 * cachehits / (cachehits + cachemisses) : 0,
+             dcfiles, dcbytes, dccopies, dcstored);
+   if(writer != AWRITE_STDIO)
+      printf("Writer %s: %ld day files, %ld bytes, %.3fs\n", awrite_name(writer), awfiles, awbytes,
+             (wend.tv_sec - wstart.tv_sec) + (wend.tv_nsec - wstart.tv_nsec) / 1e9);
+   printf("Pipeline: compute %.3fs busy %.3fs stalled, output %.3fs busy %.3fs idle, %.0f rows/s compute, %.0f rows/s output, queue depth avg %.1f max %d of %d\n",
+          pipe.computebusy, pipe.computewait, pipe.outputbusy, pipe.outputwait,
+          pipe.computebusy > 0 ? pipe.rows / pipe.computebusy : 0, pipe.outputbusy > 0 ? pipe.rows / pipe.outputbusy : 0,
+          pipe.pushes > 0 ? pipe.depthsum / pipe.pushes : 0, pipe.depthmax, PIPESLOTS);
    return 0;
 }
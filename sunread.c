@@ -0,0 +1,202 @@
+/* ------------------------------------------------------------ *
+ * file:        sunread.c                                       *
+ * purpose:     reader functions for suncalc data files, shared *
+ *              between suncalc and the tracker MCU code.       *
+ *                                                              *
+ * suncalc links this file to verify the data it generates, so *
+ * every generated file is checked with the exact same code the *
+ * MCU runs. Keep it free of floating point and libc calls.     *
+ * ------------------------------------------------------------ */
+#include "sunread.h"
+
+/* ------------------------------------------------------------ *
+ * sunread_yday() returns the day of the year, 0 for Jan-1      *
+ * ------------------------------------------------------------ */
+int16_t sunread_yday(uint16_t year, uint8_t month, uint8_t day) {
+   static const int16_t mdays[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+   int16_t yday;
+
+   if(month < 1 || month > 12) return -1;
+   yday = mdays[month - 1] + day - 1;
+   if(month > 2 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0)) yday++;
+   return yday;
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_srs_offset() returns the file offset of the record   *
+ * for a date in a slot layout srs-yyyy.bin file.               *
+ * ------------------------------------------------------------ */
+int32_t sunread_srs_offset(uint16_t year, uint8_t month, uint8_t day) {
+   int16_t yday = sunread_yday(year, month, day);
+   if(yday < 0) return -1;
+   return (int32_t) yday * SRSREC_SIZE;
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_record_offset() returns the file offset of record n  *
+ * in a packed or block aligned day file, after hsize header.   *
+ * ------------------------------------------------------------ */
+int32_t sunread_record_offset(int32_t n, uint16_t hsize, uint16_t block) {
+   int32_t per;
+
+   if(block == 0) return hsize + n * DAYREC_SIZE;
+   per = (block - hsize) / DAYREC_SIZE;
+   return (n / per) * block + hsize + (n % per) * DAYREC_SIZE;
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_daylight_record() returns the record number for      *
+ * hour:minute in a daylight day, -1 for night                  *
+ * ------------------------------------------------------------ */
+int32_t sunread_daylight_record(const struct dayhead *h, uint8_t hour, uint8_t minute) {
+   int32_t first = (int32_t) h->hour * 60 + h->minute;
+   int32_t now = (int32_t) hour * 60 + minute;
+   int32_t n;
+
+   if(h->count == 0 || h->interval == 0 || now < first) return -1;
+   n = ((now - first) * 60) / h->interval;
+   if(n >= h->count) return -1;
+   return n;
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_daylight_offset() returns the file offset of the     *
+ * record for hour:minute in a daylight day file, -1 for night  *
+ * ------------------------------------------------------------ */
+int32_t sunread_daylight_offset(const struct dayhead *h, uint8_t hour, uint8_t minute, uint16_t block) {
+   int32_t n = sunread_daylight_record(h, hour, minute);
+
+   if(n < 0) return -1;
+   return sunread_record_offset(n, sizeof(struct dayhead), block);
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_cheb_segment() returns the segment number for second *
+ * of the day sec, and its start and end second in a and b. The *
+ * first half of the segments splits sunrise to transit, second *
+ * half transit to sunset.                                      *
+ * ------------------------------------------------------------ */
+int sunread_cheb_segment(const struct chebhead *h, int32_t sec, int32_t *a, int32_t *b) {
+   int32_t start, len;
+   int first, num, k;
+
+   if(h->segments < 2 || h->setsec <= h->risesec) return -1;
+   if(sec < (int32_t) h->risesec || sec > (int32_t) h->setsec) return -1;
+   if(sec < (int32_t) h->transitsec) {
+      start = h->risesec;
+      len   = h->transitsec - h->risesec;
+      first = 0;
+      num   = h->segments / 2;
+   }
+   else {
+      start = h->transitsec;
+      len   = h->setsec - h->transitsec;
+      first = h->segments / 2;
+      num   = h->segments - first;
+   }
+   if(len <= 0) return -1;
+   k = (int) (((sec - start) * num) / len);
+   if(k >= num) k = num - 1;
+   *a = start + (len * k) / num;
+   *b = start + (len * (k + 1)) / num;
+   if(*b <= *a) return -1;
+   return first + k;
+}
+
+/* ------------------------------------------------------------ *
+ * cheb_eval() sums up the Chebyshev series with the Clenshaw   *
+ * recurrence. x is the segment time scaled to -1..1 in Q14,    *
+ * the coefficients are 1/64 degree, the result is Q14 degrees. *
+ * ------------------------------------------------------------ */
+static int32_t cheb_eval(const int16_t *c, int n, int32_t x) {
+   int32_t b1 = 0, b2 = 0, t;
+   int k;
+
+   for(k = n - 1; k >= 1; k--) {
+      t = (int32_t) c[k] * 256 + (int32_t) (((int64_t) x * b1) >> 13) - b2;
+      b2 = b1;
+      b1 = t;
+   }
+   return (int32_t) c[0] * 256 + (int32_t) (((int64_t) x * b1) >> 14) - b2;
+}
+
+/* ------------------------------------------------------------ *
+ * q14_centideg() converts Q14 degrees into 1/100 degree units  *
+ * ------------------------------------------------------------ */
+static int32_t q14_centideg(int32_t q) {
+   return (int32_t) (((int64_t) q * 100 + 8192) >> 14);
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_cheb() evaluates the sun position at second of the   *
+ * day sec, returns the day flag and the angles in 1/100 degree *
+ * ------------------------------------------------------------ */
+uint8_t sunread_cheb(const struct chebday *c, int32_t sec, int32_t *azimuth, int32_t *zenith) {
+   int32_t a, b, x;
+   int k;
+
+   k = sunread_cheb_segment(&c->head, sec, &a, &b);
+   if(k < 0) return 0;
+   /* -------------------------------------------------------- *
+    * scale sec into -1..1 (Q14). The segment count comes from *
+    * the file, so a segment can span up to 86400 sec, and     *
+    * 2 x 86400 x 16384 overflows 32 bit: multiply in 64 bit   *
+    * -------------------------------------------------------- */
+   x = (int32_t) (((int64_t) 2 * (sec - a) - (b - a)) * 16384 / (b - a));
+
+   *azimuth = q14_centideg(cheb_eval(c->azimuth[k], c->head.order, x)) % 36000;
+   if(*azimuth < 0) *azimuth += 36000;
+   *zenith = q14_centideg(cheb_eval(c->zenith[k], c->head.order, x));
+   return 1;
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_centideg() converts an IEEE double to 1/100 degree   *
+ * ------------------------------------------------------------ */
+int32_t sunread_centideg(const uint8_t *d) {
+   uint64_t bits = 0, value;
+   int32_t shift;
+   int i;
+
+   for(i = 7; i >= 0; i--) bits = (bits << 8) | d[i];
+   shift = 1075 - (int32_t) ((bits >> 52) & 0x7ff);
+   if(shift > 61) return 0;                      // zero, denormals, and below 0.0025
+   if(shift < 30) return (bits >> 63) ? -INT32_MAX : INT32_MAX;
+   /* -------------------------------------------------------- *
+    * 53 bit mantissa x 100 stays below 2^60, round half up    *
+    * -------------------------------------------------------- */
+   value = ((bits & 0xfffffffffffffULL) | (1ULL << 52)) * 100;
+   value = (value + (1ULL << (shift - 1))) >> shift;
+   return (bits >> 63) ? -(int32_t) value : (int32_t) value;
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_residual_offset() returns the file offset of record  *
+ * n in a residual day file                                     *
+ * ------------------------------------------------------------ */
+int32_t sunread_residual_offset(const struct reshead *h, int32_t n) {
+   if(n < 0 || n >= h->rows) return -1;
+   return sizeof(struct reshead) + n * 2 * h->size;
+}
+
+/* ------------------------------------------------------------ *
+ * sunread_residual() adds the residuals of record n to the     *
+ * reference record angles                                      *
+ * ------------------------------------------------------------ */
+uint8_t sunread_residual(const struct reshead *h, int32_t n, const uint8_t *ref,
+                         const uint8_t *res, int32_t *azimuth, int32_t *zenith) {
+   int32_t daz, dze;
+
+   if(h->size == 1) {
+      daz = (int8_t) res[0];
+      dze = (int8_t) res[1];
+   }
+   else {
+      daz = (int16_t) (res[0] | (res[1] << 8));
+      dze = (int16_t) (res[2] | (res[3] << 8));
+   }
+   *azimuth = (sunread_centideg(ref + 3) + daz) % 36000;
+   if(*azimuth < 0) *azimuth += 36000;
+   *zenith = sunread_centideg(ref + 11) + dze;
+   return (n >= h->first && n < h->first + h->count) ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+/* ------------------------------------------------------------ *
+ * file:        sunread.h                                       *
+ * purpose:     reader functions for suncalc data files, shared *
+ *              between suncalc and the tracker MCU code.       *
+ *                                                              *
+ * The functions only use integer math and fixed size types,   *
+ * no file access and no malloc, so they compile unchanged on   *
+ * the Arduino MKR Zero. The caller reads the file bytes and    *
+ * passes them in. Angles are returned in 1/100 degree units.   *
+ * ------------------------------------------------------------ */
+#ifndef SUNREAD_H
+#define SUNREAD_H
+
+#include <stdint.h>
+
+/* ------------------------------------------------------------ *
+ * day file record size, sizeof(struct brecord) in suncalc.c    *
+ * ------------------------------------------------------------ */
+#define DAYREC_SIZE 19
+
+/* ------------------------------------------------------------ *
+ * srs file record size, sizeof(struct drecord) in suncalc.c.   *
+ * Slot layout srs files (suncalc -s) have SRSSLOTS records,    *
+ * one per day of the year. Slots of days that were not        *
+ * calculated are all zero, a valid record has month 1..12.    *
+ * ------------------------------------------------------------ */
+#define SRSREC_SIZE 14
+#define SRSSLOTS    366
+
+/* ------------------------------------------------------------ *
+ * sunread_yday() returns the day of the year, 0 for Jan-1      *
+ * ------------------------------------------------------------ */
+int16_t sunread_yday(uint16_t year, uint8_t month, uint8_t day);
+
+/* ------------------------------------------------------------ *
+ * sunread_srs_offset() returns the file offset of the record   *
+ * for a date in a slot layout srs-yyyy.bin file.               *
+ * ------------------------------------------------------------ */
+int32_t sunread_srs_offset(uint16_t year, uint8_t month, uint8_t day);
+
+/* ------------------------------------------------------------ *
+ * dayhead is the header of daylight day files (suncalc -n),    *
+ * followed by count records from sunrise to sunset, every      *
+ * interval seconds. header size: 6 bytes                       *
+ * ------------------------------------------------------------ */
+struct dayhead {
+   uint8_t hour;                     // 0-23 first record hour
+   uint8_t minute;                   // 0-59 first record minute
+   uint16_t count;                   // number of records, 0 on polar nights
+   uint16_t interval;                // 60-3600 seconds between records
+};
+
+/* ------------------------------------------------------------ *
+ * sunread_daylight_record() returns the record number for      *
+ * hour:minute in a daylight day, or -1 for night. It is also   *
+ * used for the flash data days of suncalc -f progmem.          *
+ * ------------------------------------------------------------ */
+int32_t sunread_daylight_record(const struct dayhead *h, uint8_t hour, uint8_t minute);
+
+/* ------------------------------------------------------------ *
+ * sunread_daylight_offset() returns the file offset of the     *
+ * record for hour:minute in a daylight day file, or -1 if the  *
+ * time is before the first or after the last record (night).   *
+ * block is the dset.txt blockalign value, or 0 if not set.     *
+ * ------------------------------------------------------------ */
+int32_t sunread_daylight_offset(const struct dayhead *h, uint8_t hour, uint8_t minute, uint16_t block);
+
+/* ------------------------------------------------------------ *
+ * Block aligned day files (suncalc -b) pack a whole number of  *
+ * records into each block of blockalign bytes (the SD sector   *
+ * size), so no record crosses a sector boundary. Every block   *
+ * leaves room for the file header at its start, and the rest   *
+ * of the block after the last record is padded with zeros.    *
+ * ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ *
+ * sunread_record_offset() returns the file offset of record n  *
+ * in a day file with a header of hsize bytes. block is the     *
+ * dset.txt blockalign value, or 0 for packed records.          *
+ * ------------------------------------------------------------ */
+int32_t sunread_record_offset(int32_t n, uint16_t hsize, uint16_t block);
+
+/* ------------------------------------------------------------ *
+ * column day files (suncalc -l) split the day records into     *
+ * yyyymmdd.az, yyyymmdd.ze with the angles as 8-byte double,   *
+ * and yyyymmdd.df with the day flag byte. Record n is at file  *
+ * offset n * COLANGLE_SIZE, or n * COLFLAG_SIZE in the flags,  *
+ * with n = second of the day / interval.                       *
+ * ------------------------------------------------------------ */
+#define COLANGLE_SIZE 8
+#define COLFLAG_SIZE  1
+
+/* ------------------------------------------------------------ *
+ * Chebyshev day file yyyymmdd.chb: the sun path between sunrise *
+ * and sunset is split into CHEB_SEGMENTS time segments, half of *
+ * them before and half after the sun transit, where the azimuth *
+ * turns fastest. Each segment holds CHEB_ORDER coefficients for *
+ * azimuth and zenith angle, stored as int16_t in 1/64 degree.   *
+ * file size: 16 + 2 x 4 x 6 x 2 = 112 bytes                     *
+ * ------------------------------------------------------------ */
+#define CHEB_SEGMENTS 4
+#define CHEB_ORDER    6
+#define CHEB_SCALE    64
+
+struct chebhead {
+   uint32_t risesec;                 // 0-86400 span start, second of the day
+   uint32_t transitsec;              // 0-86400 sun transit, second of the day
+   uint32_t setsec;                  // 0-86400 span end, second of the day
+   uint8_t segments;                 // number of segments, CHEB_SEGMENTS
+   uint8_t order;                    // coefficients per segment, CHEB_ORDER
+   uint16_t maxerr;                  // max error found by suncalc, 1/100 degree
+};
+
+struct chebday {
+   struct chebhead head;
+   int16_t azimuth[CHEB_SEGMENTS][CHEB_ORDER];
+   int16_t zenith[CHEB_SEGMENTS][CHEB_ORDER];
+};
+
+/* ------------------------------------------------------------ *
+ * sunread_cheb_segment() returns the segment number for second *
+ * of the day sec, and its start and end second in a and b.     *
+ * Returns -1 if sec is outside the sunrise/sunset span.        *
+ * ------------------------------------------------------------ */
+int sunread_cheb_segment(const struct chebhead *h, int32_t sec, int32_t *a, int32_t *b);
+
+/* ------------------------------------------------------------ *
+ * sunread_cheb() evaluates the sun position at second of the   *
+ * day sec. Returns the day flag: 1 with azimuth and zenith set *
+ * in 1/100 degree, or 0 if sec is outside sunrise and sunset.  *
+ * ------------------------------------------------------------ */
+uint8_t sunread_cheb(const struct chebday *c, int32_t sec, int32_t *azimuth, int32_t *zenith);
+
+/* ------------------------------------------------------------ *
+ * sunread_centideg() converts a little endian IEEE double, as  *
+ * stored in day file records, to 1/100 degree, rounded. It     *
+ * needs no floating point, and covers +/- 10 million degrees.  *
+ * ------------------------------------------------------------ */
+int32_t sunread_centideg(const uint8_t *d);
+
+/* ------------------------------------------------------------ *
+ * Residual day file yyyymmdd.rsd (suncalc -r): for years after *
+ * the reference year (dset.txt resid-refy), each record holds  *
+ * the azimuth and zenith difference to record n of the same    *
+ * date in the reference year's yyyymmdd.bin, in 1/100 degree.  *
+ * Feb-29 uses Feb-28 if the reference year has no Feb-29. The  *
+ * day flag is 1 for the count records from record first on.  *
+ * record size: 2 x size bytes, after the 8 byte header         *
+ * ------------------------------------------------------------ */
+struct reshead {
+   uint16_t first;                   // first daylight record
+   uint16_t count;                   // number of daylight records
+   uint16_t rows;                    // number of records
+   uint8_t size;                     // 1 = int8_t, 2 = int16_t residuals
+   uint8_t reserved;                 // 0
+};
+
+/* ------------------------------------------------------------ *
+ * sunread_residual_offset() returns the file offset of record  *
+ * n in a residual day file, or -1 if n is out of range.        *
+ * ------------------------------------------------------------ */
+int32_t sunread_residual_offset(const struct reshead *h, int32_t n);
+
+/* ------------------------------------------------------------ *
+ * sunread_residual() decodes residual record n: ref is record  *
+ * n of the reference day file (19 bytes), res the 2 x size     *
+ * bytes read at sunread_residual_offset(). Returns the day     *
+ * flag, and the angles in 1/100 degree.                        *
+ * ------------------------------------------------------------ */
+uint8_t sunread_residual(const struct reshead *h, int32_t n, const uint8_t *ref,
+                         const uint8_t *res, int32_t *azimuth, int32_t *zenith);
+
+#endif